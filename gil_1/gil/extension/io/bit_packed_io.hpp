@@ -0,0 +1,378 @@
+/*
+  Copyright 2005-2006 Adobe Systems Incorporated
+  Distributed under the MIT License (see accompanying file LICENSE_1_0_0.txt
+  or a copy at http://opensource.adobe.com/licenses.html)
+*/
+
+/*************************************************************************************************/
+
+#ifndef GIL_BIT_PACKED_IO_H
+#define GIL_BIT_PACKED_IO_H
+
+/// \file
+/// \brief  Reading and writing 1 bit PBM and BMP files without expanding their pixels
+//
+/// \author Christian Henning
+///
+/// \date   2007 \n Last updated February 12, 2007
+
+#include <string.h>
+#include <string>
+#include <vector>
+#include <boost/cstdint.hpp>
+#include "bmp_io.hpp"
+#include "pnm_io.hpp"
+
+ADOBE_GIL_NAMESPACE_BEGIN
+
+/// \brief Gray image of one bit per pixel, eight pixels to a byte
+/// \ingroup IO
+/// Rows are packed from the most significant bit on and padded to whole bytes, like the rows of PBM files;
+/// a set bit is white. The padding bits of every row are zero after a read.
+class gray1_image {
+public:
+    typedef unsigned char byte_t;
+
+    gray1_image() : _width(0), _height(0), _pitch(0) {}
+    gray1_image(int width, int height) : _width(0), _height(0), _pitch(0) { recreate(width, height); }
+
+    /// Changes the dimensions, the memory is only reallocated when it grows
+    void recreate(int width, int height)
+    {
+      _width  = width;
+      _height = height;
+      _pitch  = ( std::size_t( width ) + 7 ) >> 3;
+      _bits.resize( _pitch * height );
+    }
+
+    int         width() const      { return _width;  }
+    int         height() const     { return _height; }
+    point2<int> dimensions() const { return point2<int>( _width, _height ); }
+
+    /// Bytes per row
+    std::size_t row_size() const { return _pitch; }
+
+    byte_t*       row_begin(int y)       { return _bits.empty() ? 0 : &_bits[y * _pitch]; }
+    const byte_t* row_begin(int y) const { return _bits.empty() ? 0 : &_bits[y * _pitch]; }
+
+    /// Tells whether the pixel is white
+    bool operator()(int x, int y) const
+    {
+      return ( row_begin( y )[x >> 3] >> ( 7 - ( x & 7 ))) & 1;
+    }
+
+    void set(int x, int y, bool white)
+    {
+      byte_t  bit = byte_t( 0x80 >> ( x & 7 ));
+      byte_t& pak = row_begin( y )[x >> 3];
+
+      pak = white ? byte_t( pak | bit ) : byte_t( pak & ~bit );
+    }
+
+private:
+    int                 _width;
+    int                 _height;
+    std::size_t         _pitch;
+    std::vector<byte_t> _bits;
+};
+
+namespace detail {
+
+/// Copies cnt bytes of packed pixels, inverting them when invert is set, a machine word at a time
+inline void copy_bits(const byte_t* src, byte_t* dest, std::size_t cnt, bool invert) throw()
+{
+   if( !invert )
+   {
+      memmove( dest, src, cnt );
+      return;
+   }
+
+   for( ; cnt >= 8; cnt -= 8, src += 8, dest += 8 )
+   {
+      boost::uint64_t w;
+
+      memcpy( &w, src, 8 );
+      w = ~w;
+      memcpy( dest, &w, 8 );
+   }
+
+   for( ; cnt > 0; --cnt )
+   {
+      *dest++ = byte_t( ~*src++ );
+   }
+}
+
+/// Clears the padding bits after the last pixel of a row
+inline void clear_padding(byte_t* row, int width) throw()
+{
+   if( width & 7 )
+   {
+      row[width >> 3] &= byte_t( 0xFF00 >> ( width & 7 ));
+   }
+}
+
+/// Reads PBM files (P1 and P4) into packed images. P4 rows are read whole and only inverted,
+/// PBM samples being 1 for black.
+class pnm_bit_reader : public pnm_reader {
+public:
+    pnm_bit_reader(const char* filename)    : pnm_reader(filename) {}
+    pnm_bit_reader(const wchar_t* filename) : pnm_reader(filename) {}
+
+    void read_image(gray1_image& im)
+    {
+      io_error_if( type != type_mono_asc && type != type_mono_bin
+                 , "pnm_bit_reader::read_image(): only bitmaps (P1, P4) can be read into gray1 images" );
+
+      im.recreate( width, height );
+
+      const std::size_t pitch = im.row_size();
+
+      if( width == 0 || height == 0 )
+      {
+         return;
+      }
+
+      if( type == type_mono_bin )
+      {
+         // file rows are packed like image rows, read the raster in one piece
+         byte_t* bits = im.row_begin( 0 );
+
+         io_error_if( _in.read( bits, pitch * height ) != pitch * height
+                    , "pnm_bit_reader::read_image(): unexpected end of file" );
+
+         copy_bits( bits, bits, pitch * height, true );
+      }
+      else
+      {
+         unsigned val;
+
+         for( int y = 0; y < height; ++y )
+         {
+            byte_t* row = im.row_begin( y );
+
+            memset( row, 0, pitch );
+
+            for( int x = 0; x < width; ++x )
+            {
+               io_error_if( !_in.sample( val, true ), "pnm_bit_reader::read_image(): unexpected end of file" );
+
+               if( val == 0 )
+               {
+                  row[x >> 3] |= byte_t( 0x80 >> ( x & 7 ));
+               }
+            }
+         }
+      }
+
+      for( int y = 0; y < height; ++y )
+      {
+         clear_padding( im.row_begin( y ), width );
+      }
+    }
+};
+
+/// Writes packed images as P4 files
+class pnm_bit_writer : public pnm_writer {
+public:
+    pnm_bit_writer(const char* filename)    : pnm_writer(filename) {}
+    pnm_bit_writer(const wchar_t* filename) : pnm_writer(filename) {}
+
+    void apply(const gray1_image& im)
+    {
+      const std::size_t pitch = im.row_size();
+
+      print_line( "P%i ", type_mono_bin );
+      print_line( "%i ", im.width() );
+      print_line( "%i ", im.height() );
+
+      std::vector<byte_t> bits( pitch * im.height() );
+
+      if( bits.empty() )
+      {
+         return;
+      }
+
+      copy_bits( im.row_begin( 0 ), &bits.front(), bits.size(), true );
+
+      for( int y = 0; y < im.height(); ++y )
+      {
+         clear_padding( &bits[y * pitch], im.width() );
+      }
+
+      io_error_if( write( &bits.front(), bits.size() ) != bits.size(), "pnm_bit_writer::apply(): failed to write raster" );
+    }
+};
+
+/// Reads uncompressed 1 bit BMP files into packed images. Rows are copied, and inverted when
+/// the first palette entry is the brighter one.
+class bmp_bit_reader : public bmp_reader {
+public:
+    bmp_bit_reader(const char* filename)    : bmp_reader(filename) {}
+    bmp_bit_reader(const wchar_t* filename) : bmp_reader(filename) {}
+
+    void read_image(gray1_image& im)
+    {
+      io_error_if( _info_header.bpp != 1 || _info_header.what != ct_rgb
+                 , "bmp_bit_reader::read_image(): only uncompressed 1 bit files can be read into gray1 images" );
+
+      std::vector<color_map> palette;
+      read_palette( palette );
+
+      palette.resize( 2 );
+
+      const bool invert = luminance( palette[0] ) > luminance( palette[1] );
+
+      const int width  = _info_header.width;
+      const int height = std::abs( _info_header.height );
+
+      im.recreate( width, height );
+
+      seek_raster();
+
+      const std::size_t pitch = get_pitch();
+      const std::size_t span  = im.row_size();
+
+      std::vector<byte_t> row( pitch );
+
+      for( int r = 0; r < height; ++r )
+      {
+         io_error_if( read( &row.front(), pitch ) != pitch, "bmp_bit_reader::read_image(): unexpected end of file" );
+
+         byte_t* dest = im.row_begin( _info_header.height > 0 ? height - 1 - r : r );
+
+         copy_bits( &row.front(), dest, span, invert );
+         clear_padding( dest, width );
+      }
+    }
+
+private:
+    static int luminance(const color_map& c)
+    {
+      return c.red * 4915 + c.green * 9667 + c.blue * 1802;
+    }
+};
+
+/// Writes packed images as 1 bit BMP files with a black and white palette
+class bmp_bit_writer : public bmp_writer {
+public:
+    bmp_bit_writer(const char* filename)    : bmp_writer(filename) {}
+    bmp_bit_writer(const wchar_t* filename) : bmp_writer(filename) {}
+
+    void apply(const gray1_image& im)
+    {
+      const std::size_t span = im.row_size();
+      const std::size_t spn  = ( span + 3 ) & ~std::size_t( 3 );
+
+      write_header( im.width(), im.height(), 1, ct_rgb, 0 );
+
+      // the rows bottom-up, padded to four bytes
+      std::vector<byte_t> out( spn * im.height() );
+
+      for( int y = 0; y < im.height(); ++y )
+      {
+         byte_t* dest = &out[( im.height() - 1 - y ) * spn];
+
+         memcpy( dest, im.row_begin( y ), span );
+         clear_padding( dest, im.width() );
+      }
+
+      io_error_if( !out.empty() && write( &out.front(), out.size() ) != out.size()
+                 , "bmp_bit_writer::apply(): failed to write raster" );
+    }
+};
+
+} // namespace detail
+
+/// \brief Loads a PBM file (P1 or P4) into a packed image, without expanding its pixels to bytes.
+/// \ingroup PNM_IO
+/// Throws std::ios_base::failure if the file is not a valid PBM file.
+inline void pnm_read_image(const wchar_t* filename,gray1_image& im) {
+    detail::pnm_bit_reader m(filename);
+    m.read_image(im);
+}
+
+/// \brief Loads a PBM file (P1 or P4) into a packed image, without expanding its pixels to bytes.
+/// \ingroup PNM_IO
+/// Throws std::ios_base::failure if the file is not a valid PBM file.
+inline void pnm_read_image(const char* filename,gray1_image& im) {
+    detail::pnm_bit_reader m(filename);
+    m.read_image(im);
+}
+
+/// \brief Loads a PBM file (P1 or P4) into a packed image, without expanding its pixels to bytes.
+/// \ingroup PNM_IO
+inline void pnm_read_image(const std::string& filename,gray1_image& im) {
+    pnm_read_image(filename.c_str(),im);
+}
+
+/// \brief Saves a packed image as a P4 file.
+/// \ingroup PNM_IO
+/// Throws std::ios_base::failure if it fails to create the file.
+inline void pnm_write_view(const wchar_t* filename,const gray1_image& im) {
+    detail::pnm_bit_writer m(filename);
+    m.apply(im);
+}
+
+/// \brief Saves a packed image as a P4 file.
+/// \ingroup PNM_IO
+/// Throws std::ios_base::failure if it fails to create the file.
+inline void pnm_write_view(const char* filename,const gray1_image& im) {
+    detail::pnm_bit_writer m(filename);
+    m.apply(im);
+}
+
+/// \brief Saves a packed image as a P4 file.
+/// \ingroup PNM_IO
+inline void pnm_write_view(const std::string& filename,const gray1_image& im) {
+    pnm_write_view(filename.c_str(),im);
+}
+
+/// \brief Loads an uncompressed 1 bit BMP file into a packed image, without expanding its pixels to bytes.
+/// \ingroup BMP_IO
+/// Pixels are white where their palette entry is the brighter of the two.
+/// Throws std::ios_base::failure if the file is not a valid BMP file, or if it is not an uncompressed 1 bit file.
+inline void bmp_read_image(const wchar_t* filename,gray1_image& im) {
+    detail::bmp_bit_reader m(filename);
+    m.read_image(im);
+}
+
+/// \brief Loads an uncompressed 1 bit BMP file into a packed image, without expanding its pixels to bytes.
+/// \ingroup BMP_IO
+/// Pixels are white where their palette entry is the brighter of the two.
+/// Throws std::ios_base::failure if the file is not a valid BMP file, or if it is not an uncompressed 1 bit file.
+inline void bmp_read_image(const char* filename,gray1_image& im) {
+    detail::bmp_bit_reader m(filename);
+    m.read_image(im);
+}
+
+/// \brief Loads an uncompressed 1 bit BMP file into a packed image, without expanding its pixels to bytes.
+/// \ingroup BMP_IO
+inline void bmp_read_image(const std::string& filename,gray1_image& im) {
+    bmp_read_image(filename.c_str(),im);
+}
+
+/// \brief Saves a packed image as a 1 bit BMP file with a black and white palette.
+/// \ingroup BMP_IO
+/// Throws std::ios_base::failure if it fails to create the file.
+inline void bmp_write_view(const wchar_t* filename,const gray1_image& im) {
+    detail::bmp_bit_writer m(filename);
+    m.apply(im);
+}
+
+/// \brief Saves a packed image as a 1 bit BMP file with a black and white palette.
+/// \ingroup BMP_IO
+/// Throws std::ios_base::failure if it fails to create the file.
+inline void bmp_write_view(const char* filename,const gray1_image& im) {
+    detail::bmp_bit_writer m(filename);
+    m.apply(im);
+}
+
+/// \brief Saves a packed image as a 1 bit BMP file with a black and white palette.
+/// \ingroup BMP_IO
+inline void bmp_write_view(const std::string& filename,const gray1_image& im) {
+    bmp_write_view(filename.c_str(),im);
+}
+
+ADOBE_GIL_NAMESPACE_END
+
+#endif
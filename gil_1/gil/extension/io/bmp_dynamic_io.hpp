@@ -51,22 +51,48 @@ namespace detail {
 		int bit_depth;
 	};
 
+	/// Checks the BMP format and accepts only image types that read the file with at most the given conversion
+	template <typename R> struct bmp_layout_check {
+		bmp_layout_check(const R& reader, int bit_depth, io_conversion most) throw(): _reader(reader), _format(bit_depth), _most(most) {
+		}
+
+		template <typename IMG> bool apply() {
+			return _format.template apply<IMG>() && _reader.template conversion<typename IMG::view_t>() <= _most;
+		}
+
+	private:
+		const R&             _reader;
+		bmp_format_check     _format;
+		io_conversion        _most;
+	};
+
 	/// BMP dynamic file reader
 	struct bmp_reader_dynamic: bmp_reader {
 		/// Creates reader from file
 		template <typename T> bmp_reader_dynamic(const T *file): bmp_reader(file) {
 		}
 
-		/// Reads a run-time instantiated image from file
-		template <typename IMG> void read_image(any_image<IMG>& img) {
-			if (!construct_matched(img, bmp_format_check(_info_header.bpp))) {
-				io_error("No matching image type");
-			}
-			else {
-				resize_clobber_image(img, point2<int>(_info_header.width, abs(_info_header.height)));
-				detail::dynamic_io_fnobj<bmp_read_check, bmp_reader> op(this);
-				apply_operation(view(img), op);
+		/// Creates reader from device
+		bmp_reader_dynamic(const io_device_ptr& dev): bmp_reader(dev) {
+		}
+
+		/// Reads a run-time instantiated image from file. Among the compatible types, the first one whose memory layout
+		/// needs the least conversion is chosen; returns that conversion.
+		template <typename IMG> io_conversion read_image(any_image<IMG>& img) {
+			io_conversion most = io_conversion_none;
+
+			while (!construct_matched(img, bmp_layout_check<bmp_reader_dynamic>(*this, _info_header.bpp, most))) {
+				if (most == io_conversion_expand) {
+					io_error("No matching image type");
+				}
+				most = io_conversion(most + 1);
 			}
+
+			resize_clobber_image(img, point2<int>(_info_header.width, abs(_info_header.height)));
+			detail::dynamic_io_fnobj<bmp_read_check, bmp_reader> op(this);
+			apply_operation(view(img), op);
+
+			return most;
 		}
 	};
 
@@ -88,31 +114,45 @@ namespace detail {
 
 /// \brief reads a BMP image into a run-time instantiated image
 /// \ingroup BMP_IO
-/// Opens the given BMP file name, selects the first type in Images whose color space and channel are compatible to those of the image file
-/// and creates a new image of that type with the dimensions specified by the image file.
+/// Opens the given BMP file name, selects a type in Images whose color space and channel are compatible to those of the image file
+/// and creates a new image of that type with the dimensions specified by the image file. Types whose memory layout matches the file
+/// are preferred, so that rows can be copied as they are; among equally good types the first one is chosen.
+/// Returns the conversion the read involved.
 /// Throws std::ios_base::failure if none of the types in Images are compatible with the type on disk.
 template <typename IMG> 
-inline void bmp_read_image(const wchar_t *file, any_image<IMG>& img) {
+inline io_conversion bmp_read_image(const wchar_t *file, any_image<IMG>& img) {
 	detail::bmp_reader_dynamic m(file);
-	m.read_image(img);
+	return m.read_image(img);
 }
 
 /// \brief reads a BMP image into a run-time instantiated image
 /// \ingroup BMP_IO
-/// Opens the given BMP file name, selects the first type in Images whose color space and channel are compatible to those of the image file
-/// and creates a new image of that type with the dimensions specified by the image file.
+/// Opens the given BMP file name, selects a type in Images whose color space and channel are compatible to those of the image file
+/// and creates a new image of that type with the dimensions specified by the image file. Types whose memory layout matches the file
+/// are preferred, so that rows can be copied as they are; among equally good types the first one is chosen.
+/// Returns the conversion the read involved.
 /// Throws std::ios_base::failure if none of the types in Images are compatible with the type on disk.
 template <typename IMG> 
-inline void bmp_read_image(const char *file, any_image<IMG>& img) {
+inline io_conversion bmp_read_image(const char *file, any_image<IMG>& img) {
 	detail::bmp_reader_dynamic m(file);
-	m.read_image(img);
+	return m.read_image(img);
 }
 
 /// \brief reads a BMP image into a run-time instantiated image
 /// \ingroup BMP_IO
 template <typename IMG> 
-inline void bmp_read_image(const std::string& file, any_image<IMG>& img) {
-	bmp_read_image(file.c_str(), img);
+inline io_conversion bmp_read_image(const std::string& file, any_image<IMG>& img) {
+	return bmp_read_image(file.c_str(), img);
+}
+
+/// \brief reads a BMP image from the given device into a run-time instantiated image
+/// \ingroup BMP_IO
+/// Selects the image type like the file name version does and returns the conversion the read involved.
+/// Throws std::ios_base::failure if none of the types in Images are compatible with the type on disk.
+template <typename IMG> 
+inline io_conversion bmp_read_image(const io_device_ptr& dev, any_image<IMG>& img) {
+	detail::bmp_reader_dynamic m(dev);
+	return m.read_image(img);
 }
 
 /// \brief Saves the currently instantiated view to a bmp file specified by the given bmp image file name.
@@ -142,7 +182,7 @@ template <typename V> inline void bmp_write_view(const std::string& file, const
 }
 
 /// Supported BMP images types list
-typedef boost::mpl::vector<gray8_image_t, rgb8_image_t, rgba8_image_t> bmp_types_t;
+typedef boost::mpl::vector<gray8_image_t, rgb8_image_t, bgr8_image_t, rgba8_image_t> bmp_types_t;
 
 ADOBE_GIL_NAMESPACE_END
 
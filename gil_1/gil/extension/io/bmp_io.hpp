@@ -23,6 +23,7 @@
 #include <boost/static_assert.hpp>
 #include <boost/shared_ptr.hpp>
 #include "io_error.hpp"
+#include "io_device.hpp"
 #include "bmp_io_private.hpp"
 
 ADOBE_GIL_NAMESPACE_BEGIN
@@ -51,6 +52,13 @@ template <typename VIEW> struct bmp_read_write_support {
     BOOST_STATIC_CONSTANT(bool, value=is_supported);
 };
 
+/// \brief Raster compression used when writing BMP files
+/// \ingroup BMP_IO
+enum bmp_compression {
+    bmp_compression_none = detail::ct_rgb,  ///< uncompressed raster
+    bmp_compression_rle8 = detail::ct_rle8  ///< run-length encoded 8 bit raster, gray8 views only
+};
+
 /// \brief Returns the width and height of the BMP file at the specified location.
 /// Throws std::ios_base::failure if the location does not correspond to a valid BMP file
 /// \ingroup BMP_IO
@@ -106,7 +114,7 @@ inline void bmp_read_view(const std::string& filename,const VIEW& view) {
 /// compatible with the ones specified by IMAGE
 template <typename IMAGE>
 inline void bmp_read_image(const wchar_t* filename,IMAGE& im) {
-   BOOST_STATIC_ASSERT(bmp_read_write_support<IMAGE::view_t>::is_supported);
+   BOOST_STATIC_ASSERT(bmp_read_write_support<typename IMAGE::view_t>::is_supported);
 
     detail::bmp_reader m(filename);
     m.read_image(im);
@@ -119,7 +127,7 @@ inline void bmp_read_image(const wchar_t* filename,IMAGE& im) {
 /// compatible with the ones specified by IMAGE
 template <typename IMAGE>
 inline void bmp_read_image(const char* filename,IMAGE& im) {
-   BOOST_STATIC_ASSERT(bmp_read_write_support<IMAGE::view_t>::is_supported);
+   BOOST_STATIC_ASSERT(bmp_read_write_support<typename IMAGE::view_t>::is_supported);
 
     detail::bmp_reader m(filename);
     m.read_image(im);
@@ -132,6 +140,77 @@ inline void bmp_read_image(const std::string& filename,IMAGE& im) {
     bmp_read_image(filename.c_str(),im);
 }
 
+/// \brief Loads the region of the given bmp image file whose top left corner is at (x, y) into the given view.
+/// \ingroup BMP_IO
+/// The region has the dimensions of the view. For uncompressed files only the rows and the bytes covered by the region are read.
+/// Triggers a compile assert if the view color space and channel depth are not supported by the BMP library or by the I/O extension.
+/// Throws std::ios_base::failure if the file is not a valid BMP file, or if its color space or channel depth are not 
+/// compatible with the ones specified by VIEW, or if the region doesn't lie inside the image.
+template <typename VIEW>
+inline void bmp_read_view(const wchar_t* filename,const VIEW& view,int x,int y) {
+    BOOST_STATIC_ASSERT(bmp_read_write_support<VIEW>::is_supported);
+
+    detail::bmp_reader m(filename);
+    m.apply(view,x,y);
+}
+
+/// \brief Loads the region of the given bmp image file whose top left corner is at (x, y) into the given view.
+/// \ingroup BMP_IO
+/// The region has the dimensions of the view. For uncompressed files only the rows and the bytes covered by the region are read.
+/// Triggers a compile assert if the view color space and channel depth are not supported by the BMP library or by the I/O extension.
+/// Throws std::ios_base::failure if the file is not a valid BMP file, or if its color space or channel depth are not 
+/// compatible with the ones specified by VIEW, or if the region doesn't lie inside the image.
+template <typename VIEW>
+inline void bmp_read_view(const char* filename,const VIEW& view,int x,int y) {
+    BOOST_STATIC_ASSERT(bmp_read_write_support<VIEW>::is_supported);
+
+    detail::bmp_reader m(filename);
+    m.apply(view,x,y);
+}
+
+/// \brief Loads the region of the given bmp image file whose top left corner is at (x, y) into the given view.
+/// \ingroup BMP_IO
+template <typename VIEW>
+inline void bmp_read_view(const std::string& filename,const VIEW& view,int x,int y) {
+    bmp_read_view(filename.c_str(),view,x,y);
+}
+
+/// \brief Allocates a new image of the given width and height and loads the region of the given bmp image file
+/// whose top left corner is at (x, y) into it.
+/// \ingroup BMP_IO
+/// Triggers a compile assert if the image color space or channel depth are not supported by the BMP library or by the I/O extension.
+/// Throws std::ios_base::failure if the file is not a valid BMP file, or if its color space or channel depth are not 
+/// compatible with the ones specified by IMAGE, or if the region doesn't lie inside the image.
+template <typename IMAGE>
+inline void bmp_read_image(const wchar_t* filename,IMAGE& im,int x,int y,int width,int height) {
+   BOOST_STATIC_ASSERT(bmp_read_write_support<typename IMAGE::view_t>::is_supported);
+
+    detail::bmp_reader m(filename);
+    m.read_image(im,x,y,width,height);
+}
+
+/// \brief Allocates a new image of the given width and height and loads the region of the given bmp image file
+/// whose top left corner is at (x, y) into it.
+/// \ingroup BMP_IO
+/// Triggers a compile assert if the image color space or channel depth are not supported by the BMP library or by the I/O extension.
+/// Throws std::ios_base::failure if the file is not a valid BMP file, or if its color space or channel depth are not 
+/// compatible with the ones specified by IMAGE, or if the region doesn't lie inside the image.
+template <typename IMAGE>
+inline void bmp_read_image(const char* filename,IMAGE& im,int x,int y,int width,int height) {
+   BOOST_STATIC_ASSERT(bmp_read_write_support<typename IMAGE::view_t>::is_supported);
+
+    detail::bmp_reader m(filename);
+    m.read_image(im,x,y,width,height);
+}
+
+/// \brief Allocates a new image of the given width and height and loads the region of the given bmp image file
+/// whose top left corner is at (x, y) into it.
+/// \ingroup BMP_IO
+template <typename IMAGE>
+inline void bmp_read_image(const std::string& filename,IMAGE& im,int x,int y,int width,int height) {
+    bmp_read_image(filename.c_str(),im,x,y,width,height);
+}
+
 /// \brief Saves the view to a bmp file specified by the given bmp image file name.
 /// \ingroup bmp_IO
 /// Triggers a compile assert if the view color space and channel depth are not supported by the bmp library or by the I/O extension.
@@ -163,6 +242,140 @@ inline void bmp_write_view(const std::string& filename,const VIEW& view ) {
     bmp_write_view(filename.c_str(),view);
 }
 
+/// \brief Saves the view to a bmp file specified by the given bmp image file name using the given compression.
+/// \ingroup BMP_IO
+/// Triggers a compile assert if the view color space and channel depth are not supported by the bmp library or by the I/O extension.
+/// Throws std::ios_base::failure if it fails to create the file or the compression can't be applied to the view.
+template <typename VIEW>
+inline void bmp_write_view(const wchar_t* filename,const VIEW& view,bmp_compression compression) {
+    BOOST_STATIC_ASSERT(bmp_read_write_support<VIEW>::is_supported);
+
+    detail::bmp_writer m(filename);
+    m.apply(view,compression);
+}
+
+/// \brief Saves the view to a bmp file specified by the given bmp image file name using the given compression.
+/// \ingroup BMP_IO
+/// Triggers a compile assert if the view color space and channel depth are not supported by the bmp library or by the I/O extension.
+/// Throws std::ios_base::failure if it fails to create the file or the compression can't be applied to the view.
+template <typename VIEW>
+inline void bmp_write_view(const char* filename,const VIEW& view,bmp_compression compression) {
+    BOOST_STATIC_ASSERT(bmp_read_write_support<VIEW>::is_supported);
+
+    detail::bmp_writer m(filename);
+    m.apply(view,compression);
+}
+
+/// \brief Saves the view to a bmp file specified by the given bmp image file name using the given compression.
+/// \ingroup BMP_IO
+template <typename VIEW>
+inline void bmp_write_view(const std::string& filename,const VIEW& view,bmp_compression compression) {
+    bmp_write_view(filename.c_str(),view,compression);
+}
+
+/// \brief Loads a bmp image from the given device, such as a receive buffer, into the given view.
+/// \ingroup BMP_IO
+/// Triggers a compile assert if the view color space and channel depth are not supported by the BMP library or by the I/O extension.
+/// Throws std::ios_base::failure if the data is not a valid BMP file, or if its color space or channel depth are not
+/// compatible with the ones specified by VIEW, or if its dimensions don't match the ones of the view.
+template <typename VIEW>
+inline void bmp_read_view(const io_device_ptr& dev,const VIEW& view) {
+    BOOST_STATIC_ASSERT(bmp_read_write_support<VIEW>::is_supported);
+
+    detail::bmp_reader m(dev);
+    m.apply(view);
+}
+
+/// \brief Allocates a new image whose dimensions are determined by the bmp image read from the given device, and loads the pixels into it.
+/// \ingroup BMP_IO
+/// Triggers a compile assert if the image color space or channel depth are not supported by the BMP library or by the I/O extension.
+/// Throws std::ios_base::failure if the data is not a valid BMP file, or if its color space or channel depth are not
+/// compatible with the ones specified by IMAGE
+template <typename IMAGE>
+inline void bmp_read_image(const io_device_ptr& dev,IMAGE& im) {
+   BOOST_STATIC_ASSERT(bmp_read_write_support<typename IMAGE::view_t>::is_supported);
+
+    detail::bmp_reader m(dev);
+    m.read_image(im);
+}
+
+/// \brief Saves the view as a bmp image to the given device.
+/// \ingroup BMP_IO
+/// Triggers a compile assert if the view color space and channel depth are not supported by the bmp library or by the I/O extension.
+template <typename VIEW>
+inline void bmp_write_view(const io_device_ptr& dev,const VIEW& view ) {
+    BOOST_STATIC_ASSERT(bmp_read_write_support<VIEW>::is_supported);
+
+    detail::bmp_writer m(dev);
+    m.apply(view);
+}
+
+/// \brief Memory-maps a BMP file and gives read-only access to its pixels without decoding or copying them.
+/// \ingroup BMP_IO
+/// VIEW must be gray8c_view_t, bgr8c_view_t or bgra8c_view_t and match the 8 (gray palette), 24 or 32 bits
+/// per pixel layout of the file. Bottom-up files are viewed through a negative row stride. The view stays
+/// valid as long as this object, or a copy of it, is alive.
+/// Throws std::ios_base::failure if the file is not a valid BMP file or its layout doesn't match VIEW.
+template <typename VIEW>
+class bmp_mapped_image {
+public:
+    typedef VIEW view_t;
+
+    explicit bmp_mapped_image(const char* filename)
+    : _reader(filename)
+    , _view(_reader.get_view<VIEW>()) {}
+
+    explicit bmp_mapped_image(const std::string& filename)
+    : _reader(filename.c_str())
+    , _view(_reader.get_view<VIEW>()) {}
+
+    const view_t& view() const { return _view; }
+
+    point2<int> dimensions() const { return _view.dimensions(); }
+
+private:
+    detail::bmp_mapped_reader _reader;
+    view_t                    _view;
+};
+
+/// \brief Writes a BMP file row by row, for images that are produced in bands and never exist in memory at once.
+/// \ingroup BMP_IO
+/// The header with the final dimensions is written on construction. The rows are stored top-down (negative height),
+/// so they are pushed in their natural order, from the top row to the bottom row, with write_row() or write_rows().
+/// finish() completes the file.
+/// Triggers a compile assert if the view color space and channel depth are not supported by the bmp library or by the I/O extension.
+/// Throws std::ios_base::failure if it fails to create or write the file, or if more or fewer rows than the height are pushed.
+template <typename VIEW>
+class bmp_scanline_writer {
+    BOOST_STATIC_ASSERT(bmp_read_write_support<VIEW>::is_supported);
+
+public:
+    typedef VIEW view_t;
+
+    bmp_scanline_writer(const wchar_t* filename, int width, int height)
+    : _writer(filename, width, height) {}
+
+    bmp_scanline_writer(const char* filename, int width, int height)
+    : _writer(filename, width, height) {}
+
+    bmp_scanline_writer(const std::string& filename, int width, int height)
+    : _writer(filename.c_str(), width, height) {}
+
+    /// Writes the next row, which holds as many pixels as the image is wide
+    void write_row(typename view_t::x_iterator row) { _writer.write_row(row); }
+
+    /// Writes the rows of a band as wide as the image
+    void write_rows(const view_t& band) { _writer.write_rows(band); }
+
+    /// Checks that all rows have been written and flushes the file
+    void finish() { _writer.finish(); }
+
+    int rows_written() const { return _writer.rows_written(); }
+
+private:
+    detail::bmp_stream_writer<VIEW> _writer;
+};
+
 ADOBE_GIL_NAMESPACE_END
 
 #endif
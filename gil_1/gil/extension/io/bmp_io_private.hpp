@@ -18,11 +18,17 @@
 /// \date   2005-2007 \n Last updated January 21, 2007
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <boost/static_assert.hpp>
 #include <boost/scoped_array.hpp>
+#include <boost/type_traits/remove_const.hpp>
 #include <vector>
+#include <algorithm>
 #include "../../core/gil_all.hpp"
 #include "io_error.hpp"
+#include "io_device.hpp"
+#include "mapped_file.hpp"
+#include "row_convert.hpp"
 
 ADOBE_GIL_NAMESPACE_BEGIN
 
@@ -111,6 +117,32 @@ template <> struct bmp_read_write_support_private<bits8, rgba_t> {
 	};
 };
 
+/// Determines the bits per pixel of a BMP raster that can be viewed in place through the given pixel iterator
+template <typename It> struct bmp_mapped_support_private {
+	enum {
+		supported	= false,
+		pixel		= 0
+	};
+};
+template <> struct bmp_mapped_support_private<gray8c_ptr_t> {
+	enum {
+		supported	= true,
+		pixel		= 8
+	};
+};
+template <> struct bmp_mapped_support_private<bgr8c_ptr_t> {
+	enum {
+		supported	= true,
+		pixel		= 24
+	};
+};
+template <> struct bmp_mapped_support_private<bgra8c_ptr_t> {
+	enum {
+		supported	= true,
+		pixel		= 32
+	};
+};
+
 /// Assembles and disassembles pixel of given type
 template <typename V, typename C> struct convertor {
 };
@@ -184,146 +216,503 @@ template <typename V> struct convertor<V, rgba_t> {
 	}
 };			
 
+/// Checks for the given channel bit masks
+inline bool is_color_mask(const color_mask& msk, unsigned r, unsigned g, unsigned b) throw() {
+	return msk.red.mask == r && msk.green.mask == g && msk.blue.mask == b;
+}
+
+/// Checks for an 8 bit palette mapping every index to the gray level of the same value
+inline bool is_gray_ramp(const std::vector<color_map>& palette) throw() {
+	bool gray = palette.size() == 256;
+
+	for (std::size_t i = 0; gray && i < palette.size(); ++i) {
+		gray = palette[i].red == i && palette[i].green == i && palette[i].blue == i;
+	}
+	return gray;
+}
+
+/// Tells whether rows of the given pixel iterator are stored exactly like BMP rows of bpp bits per pixel
+template <typename It> struct bmp_direct_row {
+	static bool matches(int bpp) throw() {
+		return false;
+	}
+
+	static byte_t *bytes(It src) throw() {
+		return 0;
+	}
+};
+
+template <typename P> struct bmp_direct_row<P*> {
+	static bool matches(int bpp) throw() {
+		return (int(byte_layout<P*>::value) == layout_bgr  && bpp == 24)
+		    || (int(byte_layout<P*>::value) == layout_gray && bpp == 8);
+	}
+
+	static const byte_t *bytes(const P *src) throw() {
+		return reinterpret_cast<const byte_t*>(src);
+	}
+
+	/// Rows of mutable views are read into
+	static byte_t *bytes(typename boost::remove_const<P>::type *src) throw() {
+		return reinterpret_cast<byte_t*>(src);
+	}
+};
+
+/// Row conversions that run on a vectorized kernel or a plain copy, chosen by the byte layout of the view
+template <int Layout> struct bmp_fast_row {
+	/// From BMP to GIL, returns 0 when there is no fast conversion
+	template <typename T> static typename T::read_fn reader(int bpp, const color_mask& msk) throw() {
+		return 0;
+	}
+
+	/// From GIL to BMP, returns 0 when there is no fast conversion
+	template <typename T> static typename T::write_fn writer(int bpp) throw() {
+		return 0;
+	}
+};
+
+template <> struct bmp_fast_row<layout_gray> {
+	template <typename T> static typename T::read_fn reader(int bpp, const color_mask& msk) throw() {
+		return 0;
+	}
+
+	template <typename T> static typename T::write_fn writer(int bpp) throw() {
+		return (bpp == 8) ? &write_8<typename T::iterator_t> : 0;
+	}
+
+	template <typename It> static void write_8(It src, byte_t *dest, int cnt) {
+		memcpy(dest, src, cnt);
+	}
+};
+
+template <> struct bmp_fast_row<layout_rgb> {
+	template <typename T> static typename T::read_fn reader(int bpp, const color_mask& msk) throw() {
+		typedef typename T::iterator_t It;
+
+		switch (bpp)
+		{
+		case 15:
+		case 16:
+			if (is_color_mask(msk, 0x7C00, 0x03E0, 0x001F)) return &read_555<It>;
+			if (is_color_mask(msk, 0xF800, 0x07E0, 0x001F)) return &read_565<It>;
+			break;
+
+		case 24:
+			return &read_24<It>;
+		}
+		return 0;
+	}
+
+	template <typename T> static typename T::write_fn writer(int bpp) throw() {
+		return (bpp == 24) ? &write_24<typename T::iterator_t> : 0;
+	}
+
+	template <typename It> static void read_555(const byte_t *src, It dest, int cnt, const color_map pal[], const color_mask& msk) {
+		get_row_kernels().unpack_555(src, reinterpret_cast<byte_t*>(dest), cnt);
+	}
+
+	template <typename It> static void read_565(const byte_t *src, It dest, int cnt, const color_map pal[], const color_mask& msk) {
+		get_row_kernels().unpack_565(src, reinterpret_cast<byte_t*>(dest), cnt);
+	}
+
+	template <typename It> static void read_24(const byte_t *src, It dest, int cnt, const color_map pal[], const color_mask& msk) {
+		get_row_kernels().swap_rb_24(src, reinterpret_cast<byte_t*>(dest), cnt);
+	}
+
+	template <typename It> static void write_24(It src, byte_t *dest, int cnt) {
+		get_row_kernels().swap_rb_24(reinterpret_cast<const byte_t*>(src), dest, cnt);
+	}
+};
+
+template <> struct bmp_fast_row<layout_bgr> {
+	template <typename T> static typename T::read_fn reader(int bpp, const color_mask& msk) throw() {
+		return (bpp == 24) ? &read_24<typename T::iterator_t> : 0;
+	}
+
+	template <typename T> static typename T::write_fn writer(int bpp) throw() {
+		return (bpp == 24) ? &write_24<typename T::iterator_t> : 0;
+	}
+
+	template <typename It> static void read_24(const byte_t *src, It dest, int cnt, const color_map pal[], const color_mask& msk) {
+		memcpy(dest, src, cnt * 3);
+	}
+
+	template <typename It> static void write_24(It src, byte_t *dest, int cnt) {
+		memcpy(dest, src, cnt * 3);
+	}
+};
+
+template <> struct bmp_fast_row<layout_rgba> {
+	template <typename T> static typename T::read_fn reader(int bpp, const color_mask& msk) throw() {
+		return (bpp == 32 && is_color_mask(msk, 0xFF0000, 0x00FF00, 0x0000FF)) ? &read_32<typename T::iterator_t> : 0;
+	}
+
+	template <typename T> static typename T::write_fn writer(int bpp) throw() {
+		return (bpp == 32) ? &write_32<typename T::iterator_t> : 0;
+	}
+
+	template <typename It> static void read_32(const byte_t *src, It dest, int cnt, const color_map pal[], const color_mask& msk) {
+		get_row_kernels().bgrx_to_rgba(src, reinterpret_cast<byte_t*>(dest), cnt);
+	}
+
+	template <typename It> static void write_32(It src, byte_t *dest, int cnt) {
+		get_row_kernels().rgba_to_bgrx(reinterpret_cast<const byte_t*>(src), dest, cnt);
+	}
+};
+
+/// Color palette converted to the target pixel type, built once per image.
+/// For 1 and 4 bit indices it also holds the pixels of every possible byte, so
+/// that one lookup emits eight or two pixels.
+template <typename V, typename C> class palette_lut {
+public:
+	typedef typename V::x_iterator iterator_t;
+	typedef typename V::pixel_t    pixel_t;
+
+	palette_lut(const std::vector<color_map>& palette, int bpp) : _bpp(bpp), _lut(256) {
+		// indices beyond the palette get the first entry
+		pixel_t bg = palette.empty() ? convertor<V, C>::make(0, 0, 0)
+		                             : convertor<V, C>::make(palette[0].red, palette[0].green, palette[0].blue);
+
+		std::fill(_lut.begin(), _lut.end(), bg);
+
+		for (std::size_t i = 0; i < palette.size() && i < _lut.size(); ++i) {
+			_lut[i] = convertor<V, C>::make(palette[i].red, palette[i].green, palette[i].blue);
+		}
+
+		if (bpp == 1 || bpp == 4) {
+			int per  = 8 / bpp;
+			int mask = (1 << bpp) - 1;
+
+			_expand.resize(256 * per);
+
+			for (int b = 0; b < 256; ++b) {
+				for (int k = 0; k < per; ++k) {
+					_expand[b * per + k] = _lut[(b >> (8 - bpp * (k + 1))) & mask];
+				}
+			}
+		}
+	}
+
+	const pixel_t& operator[](int idx) const throw() {
+		return _lut[idx];
+	}
+
+	/// Converts one row of 1, 4 or 8 bit indices, starting skip pixels into the first byte
+	void read_row(const byte_t *src, iterator_t dest, int cnt, int skip = 0) const throw() {
+		if (_bpp == 8) {
+			for (; cnt > 0; --cnt, ++src, ++dest) {
+				*dest = _lut[*src];
+			}
+			return;
+		}
+
+		int per = 8 / _bpp;
+
+		if (skip > 0 && cnt > 0) {
+			const pixel_t *e = &_expand[*src++ * per];
+			int            n = std::min(per - skip, cnt);
+
+			std::copy(e + skip, e + skip + n, dest);
+			dest += n;
+			cnt  -= n;
+		}
+
+		for (; cnt >= per; cnt -= per, dest += per) {
+			const pixel_t *e = &_expand[*src++ * per];
+			std::copy(e, e + per, dest);
+		}
+		if (cnt > 0) {
+			const pixel_t *e = &_expand[*src * per];
+			std::copy(e, e + cnt, dest);
+		}
+	}
+
+private:
+	int                  _bpp;
+	std::vector<pixel_t> _lut;
+	std::vector<pixel_t> _expand;
+};
+
 /// Transfers and converts row of pixels
 template <typename V, typename C> struct transfer {
 	typedef typename V::x_iterator iterator_t;
 	typedef typename V::pixel_t    pixel_t;
 	typedef typename V::channel_t  channel_t;
 
+	/// Converts one row from BMP to GIL
+	typedef void (*read_fn)(const byte_t *src, iterator_t dest, int cnt, const color_map pal[], const color_mask& msk);
+
+	/// Converts one row from GIL to BMP
+	typedef void (*write_fn)(iterator_t src, byte_t *dest, int cnt);
+
+	/// Selects the row conversion from BMP to GIL, once per image
+	static read_fn reader(int bpp, const color_mask& msk) throw() {
+		read_fn fn = bmp_fast_row<byte_layout<iterator_t>::value>::template reader<transfer>(bpp, msk);
+
+		if (fn) {
+			return fn;
+		}
+
+		switch (bpp)
+		{
+		case 1:  return &read_1;
+		case 4:  return &read_4;
+		case 8:  return &read_8;
+		case 15:
+		case 16: return &read_16;
+		case 24: return &read_24;
+		case 32: return &read_32;
+		}
+		return &read_none;
+	}
+
+	/// Selects the row conversion from GIL to BMP, once per image
+	static write_fn writer(int bpp) throw() {
+		write_fn fn = bmp_fast_row<byte_layout<iterator_t>::value>::template writer<transfer>(bpp);
+
+		if (fn) {
+			return fn;
+		}
+
+		switch (bpp)
+		{
+		case 8:  return &write_8;
+		case 24: return &write_24;
+		case 32: return &write_32;
+		}
+		return &write_none;
+	}
+
 	/// From BMP to GIL
 	static void convert(int bpp, const byte_t *src, iterator_t dest, int cnt, const color_map pal[], const color_mask& msk) throw() {
+		reader(bpp, msk)(src, dest, cnt, pal, msk);
+	}
+
+	/// From GIL to BMP
+	static void convert(int bpp, iterator_t src, byte_t *dest, int cnt) throw() {
+		writer(bpp)(src, dest, cnt);
+	}
+
+	static void read_none(const byte_t *src, iterator_t dest, int cnt, const color_map pal[], const color_mask& msk) throw() {
+	}
+
+	/// 1 indexed
+	static void read_1(const byte_t *src, iterator_t dest, int cnt, const color_map pal[], const color_mask& msk) throw() {
 		unsigned bit;
 		byte_t   pak, idx;
 
-		switch (bpp)
-		{
-		case 1:
-			// 1 indexed
-			for (bit = 0; cnt > 0; --cnt, ++dest) {
-				if (bit == 0) {
-					bit = 8;
-					pak = *src++;
-				}
-				idx = (pak >> --bit) & 0x01;
-
-				*dest = convertor<V, C>::make(pal[idx].red, pal[idx].green, pal[idx].blue);
+		for (bit = 0; cnt > 0; --cnt, ++dest) {
+			if (bit == 0) {
+				bit = 8;
+				pak = *src++;
 			}
-			break;
+			idx = (pak >> --bit) & 0x01;
 
-		case 4:
-			// 4 indexed
-			for (bit = 0; cnt > 0; --cnt, ++dest) {
-				if (bit == 0) {
-					bit = 8;
-					pak = *src++;
-				}
-				bit -= 4;
-				idx = (pak >> bit) & 0x0F;
+			*dest = convertor<V, C>::make(pal[idx].red, pal[idx].green, pal[idx].blue);
+		}
+	}
 
-				*dest = convertor<V, C>::make(pal[idx].red, pal[idx].green, pal[idx].blue);
-			}
-			break;
+	/// 4 indexed
+	static void read_4(const byte_t *src, iterator_t dest, int cnt, const color_map pal[], const color_mask& msk) throw() {
+		unsigned bit;
+		byte_t   pak, idx;
 
-		case 8:
-			// 8 indexed
-			for (; cnt > 0; --cnt, ++src, ++dest) {
-				idx = *src;
-				*dest = convertor<V, C>::make(pal[idx].red, pal[idx].green, pal[idx].blue);
+		for (bit = 0; cnt > 0; --cnt, ++dest) {
+			if (bit == 0) {
+				bit = 8;
+				pak = *src++;
 			}
-			break;
+			bit -= 4;
+			idx = (pak >> bit) & 0x0F;
 
-		case 15:
-		case 16:
-			// 5-5-5, 5-6-5 BGR
-			for (; cnt > 0; --cnt, ++dest, src += 2) {
-				int p = (src[1] << 8) | src[0];
+			*dest = convertor<V, C>::make(pal[idx].red, pal[idx].green, pal[idx].blue);
+		}
+	}
 
-				int r = ((p & msk.red.mask)   >> msk.red.shift)   << (8 - msk.red.width);
-				int g = ((p & msk.green.mask) >> msk.green.shift) << (8 - msk.green.width);
-				int b = ((p & msk.blue.mask)  >> msk.blue.shift)  << (8 - msk.blue.width);
+	/// 8 indexed
+	static void read_8(const byte_t *src, iterator_t dest, int cnt, const color_map pal[], const color_mask& msk) throw() {
+		byte_t idx;
 
-				*dest = convertor<V, C>::make(r, g, b);
-			}
-			break;
+		for (; cnt > 0; --cnt, ++src, ++dest) {
+			idx = *src;
+			*dest = convertor<V, C>::make(pal[idx].red, pal[idx].green, pal[idx].blue);
+		}
+	}
 
-		case 24:
-			// 8-8-8 BGR
-			for (; cnt > 0; --cnt, ++dest) {
-				byte_t b = *src++;
-				byte_t g = *src++;
-				byte_t r = *src++;
+	/// 5-5-5, 5-6-5 BGR
+	static void read_16(const byte_t *src, iterator_t dest, int cnt, const color_map pal[], const color_mask& msk) throw() {
+		for (; cnt > 0; --cnt, ++dest, src += 2) {
+			int p = (src[1] << 8) | src[0];
 
-				*dest = convertor<V, C>::make(r, g, b);
-			}
-			break;
+			int r = ((p & msk.red.mask)   >> msk.red.shift)   << (8 - msk.red.width);
+			int g = ((p & msk.green.mask) >> msk.green.shift) << (8 - msk.green.width);
+			int b = ((p & msk.blue.mask)  >> msk.blue.shift)  << (8 - msk.blue.width);
 
-		case 32:
-			// 8-8-8-8 BGR*
-			for (; cnt > 0; --cnt, ++dest) {
-				byte_t b = *src++;
-				byte_t g = *src++;
-				byte_t r = *src++;
-				byte_t a = *src++;
+			*dest = convertor<V, C>::make(r, g, b);
+		}
+	}
 
-				*dest = convertor<V, C>::make(r, g, b);
-			}
-			break;
+	/// 8-8-8 BGR
+	static void read_24(const byte_t *src, iterator_t dest, int cnt, const color_map pal[], const color_mask& msk) throw() {
+		for (; cnt > 0; --cnt, ++dest) {
+			byte_t b = *src++;
+			byte_t g = *src++;
+			byte_t r = *src++;
+
+			*dest = convertor<V, C>::make(r, g, b);
 		}
 	}
 
-	/// From GIL to BMP
-	static void convert(int bpp, iterator_t src, byte_t *dest, int cnt) throw() {
+	/// 8-8-8-8 BGR*
+	static void read_32(const byte_t *src, iterator_t dest, int cnt, const color_map pal[], const color_mask& msk) throw() {
+		for (; cnt > 0; --cnt, ++dest) {
+			byte_t b = *src++;
+			byte_t g = *src++;
+			byte_t r = *src++;
+			byte_t a = *src++;
+
+			*dest = convertor<V, C>::make(r, g, b);
+		}
+	}
+
+	static void write_none(iterator_t src, byte_t *dest, int cnt) throw() {
+	}
+
+	/// 8
+	static void write_8(iterator_t src, byte_t *dest, int cnt) throw() {
 		channel_t r, g, b, a;
 
-		switch (bpp)
-		{
-		case 8:
-			// 8
-			for (; cnt > 0; --cnt, ++src, ++dest) {
-				convertor<V, C>::split(*src, r, g, b, a);
-				*dest = g;
-			}
-			break;
+		for (; cnt > 0; --cnt, ++src, ++dest) {
+			convertor<V, C>::split(*src, r, g, b, a);
+			*dest = g;
+		}
+	}
 
-		case 24:
-			// 8-8-8
-			for (; cnt > 0; --cnt, ++src) {
-				convertor<V, C>::split(*src, r, g, b, a);
+	/// 8-8-8
+	static void write_24(iterator_t src, byte_t *dest, int cnt) throw() {
+		channel_t r, g, b, a;
 
-				*dest++ = b;
-				*dest++ = g;
-				*dest++ = r;
-			}
-			break;
+		for (; cnt > 0; --cnt, ++src) {
+			convertor<V, C>::split(*src, r, g, b, a);
 
-		case 32:
-			// 8-8-8-8
-			for (; cnt > 0; --cnt, ++src) {
-				convertor<V, C>::split(*src, r, g, b, a);
+			*dest++ = b;
+			*dest++ = g;
+			*dest++ = r;
+		}
+	}
+
+	/// 8-8-8-8
+	static void write_32(iterator_t src, byte_t *dest, int cnt) throw() {
+		channel_t r, g, b, a;
+
+		for (; cnt > 0; --cnt, ++src) {
+			convertor<V, C>::split(*src, r, g, b, a);
+
+			*dest++ = b;
+			*dest++ = g;
+			*dest++ = r;
+			*dest++ = 0;
+		}
+	}
+};
+
+/// Buffered byte source for decoding RLE compressed rasters
+class rle_source {
+public:
+	rle_source(io_device& dev) : _dev(dev), _buf(4096), _pos(0), _end(0) {}
 
-				*dest++ = b;
-				*dest++ = g;
-				*dest++ = r;
-				*dest++ = 0;
+	/// Returns the next byte or EOF
+	int next() throw() {
+		if (_pos == _end) {
+			_pos = 0;
+			_end = _dev.read(&_buf.front(), _buf.size());
+
+			if (_end == 0) {
+				return EOF;
 			}
-			break;
 		}
+		return _buf[_pos++];
 	}
+
+private:
+	io_device&          _dev;
+	std::vector<byte_t> _buf;
+	std::size_t         _pos, _end;
 };
 
+/// Appends one row of 8 bit indices to an RLE8 stream, terminated by an end of line marker
+inline void encode_rle8(const byte_t *src, int cnt, std::vector<byte_t>& out) {
+	for (int x = 0; x < cnt; ) {
+		// encoded mode for runs of two or more equal indices
+		int run = 1;
+
+		while (x + run < cnt && run < 255 && src[x + run] == src[x]) {
+			++run;
+		}
+		if (run > 1) {
+			out.push_back(byte_t(run));
+			out.push_back(src[x]);
+			x += run;
+			continue;
+		}
+
+		// absolute mode until the next run of at least three equal indices
+		int lit = 1;
+
+		while (x + lit < cnt && lit < 255) {
+			const byte_t *p = src + x + lit;
+
+			if (x + lit + 2 < cnt && p[0] == p[1] && p[0] == p[2]) {
+				break;
+			}
+			++lit;
+		}
+		if (lit < 3) {
+			// absolute mode needs at least three pixels
+			for (int i = 0; i < lit; ++i) {
+				out.push_back(1);
+				out.push_back(src[x + i]);
+			}
+		}
+		else {
+			out.push_back(0);
+			out.push_back(byte_t(lit));
+			out.insert(out.end(), src + x, src + x + lit);
+
+			// absolute runs are padded to a 16 bit boundary
+			if (lit & 1) {
+				out.push_back(0);
+			}
+		}
+		x += lit;
+	}
+	out.push_back(0);
+	out.push_back(0);
+}
+
 class bmp_reader : public file_mgr {
 protected:
    info_header _info_header;
    file_header _file_header;
 
+    /// File and information headers, color masks and palette, as read in one piece by init()
+    std::vector<byte_t> _header;
+
+    /// Offset in _header of what follows the information header
+    std::size_t _extra;
+
+    /// Whether the device is still at the raster, where init() stopped reading
+    bool _at_raster;
+
     void init() {
 
-      // Read file header.
-      _file_header.type = read_int16();
-      _file_header.size = read_int32();
-      read_int16(); // read reserved bytes
-      read_int16(); // read reserved bytes
-      _file_header.offset = read_int32();
+      // Read the file header and the info header size.
+      byte_t fh[header_size + 4] = { 0 };
+      read(fh);
+
+      _file_header.type   = get_int16(fh);
+      _file_header.size   = get_int32(fh + 2);
+      _file_header.offset = get_int32(fh + 10);
 
       if (_file_header.type != bm_signature) {
 	      io_error("file_mgr: not a BMP file");
@@ -333,38 +722,47 @@ protected:
 	      io_error("file_mgr: invalid BMP file header");
       }
 
-      // Read the info header size.
-      int info_header_size = read_int32();
+      int info_header_size = get_int32(fh + header_size);
+
+      if (info_header_size != win32_info_size && info_header_size != os2_info_size) {
+	      io_error("file_mgr: invalid BMP info header");
+      }
+
+      // Read the rest of the headers in one piece, as much as the largest color masks and palette
+      // would take but never past the raster, so that files which can't seek back still decode.
+      _extra = header_size + info_header_size;
+
+      std::size_t len = std::max<std::size_t>(std::min<std::size_t>(std::max<long>(_file_header.offset, 0), _extra + 12 + 256 * 4), _extra);
+
+      _header.assign(len, 0);
+      std::copy(fh, fh + sizeof(fh), _header.begin());
+      _at_raster = read(&_header[sizeof(fh)], len - sizeof(fh)) == len - sizeof(fh)
+                && len == std::size_t(_file_header.offset);
+
+      const byte_t* info = &_header[header_size + 4];
 
       if( info_header_size == win32_info_size )
       {
 	      // Windows header
-	      _info_header.width  = read_int32();
-	      _info_header.height = read_int32();
-	      _info_header.planes = read_int16();
-	      _info_header.bpp    = read_int16();
-	      _info_header.what   = read_int32();
-					         read_int32();
-					         read_int32();
-					         read_int32();
-	      _info_header.colors = read_int32();
-					         read_int32();
+	      _info_header.width  = boost::int32_t(get_int32(info));
+	      _info_header.height = boost::int32_t(get_int32(info + 4));
+	      _info_header.planes = get_int16(info + 8);
+	      _info_header.bpp    = get_int16(info + 10);
+	      _info_header.what   = get_int32(info + 12);
+	      _info_header.colors = get_int32(info + 28);
 	      _info_header.entry  = 4;
       }
-      else if ( info_header_size == os2_info_size )
+      else
       {
 	      // OS2 header
-	      _info_header.width  = read_int16();
-	      _info_header.height = read_int16();
-	      _info_header.planes = read_int16();
-	      _info_header.bpp    = read_int16();
+	      _info_header.width  = get_int16(info);
+	      _info_header.height = get_int16(info + 2);
+	      _info_header.planes = get_int16(info + 4);
+	      _info_header.bpp    = get_int16(info + 6);
 	      _info_header.what   = ct_rgb;
 	      _info_header.colors = 0;
 	      _info_header.entry  = 3;
       }
-      else {
-	      io_error("file_mgr: invalid BMP info header");
-      }
 
       /// check supported bits per pixel
       if (_info_header.bpp < 1 || _info_header.bpp > 32) {
@@ -373,25 +771,26 @@ protected:
     }
 
 
-public:
-    bmp_reader(FILE* file)           : file_mgr(file)           { init(); }
-    bmp_reader(const char* filename) : file_mgr(filename, "rb") { init(); }
-    bmp_reader(const wchar_t* filename) : file_mgr(filename, L"rb") { init(); }
-
-   template <typename VIEW>
-   void apply( const VIEW& view )
+   /// Positions the device at the first raster row, unless init() left it there
+   void seek_raster()
    {
-      io_error_if( view.dimensions() != get_dimensions()
-                 , "bmp_reader::apply(): input view dimensions do not match the image file");
-
-      color_mask mask;
+      if( !_at_raster )
+      {
+         io_error_if( seek( _file_header.offset ) != 0, "bmp_reader: failed to seek to the raster" );
+      }
+      _at_raster = false;
+   }
 
-      // read the color masks
+   /// Reads the color masks following the info header
+   void read_color_mask( color_mask& mask ) const
+   {
       if( _info_header.what == ct_bitfield )
       {
-         mask.red.mask    = read_int32();
-         mask.green.mask  = read_int32();
-         mask.blue.mask   = read_int32();
+         io_error_if( _header.size() < _extra + 12, "bmp_reader::apply(): color masks overlap the raster" );
+
+         mask.red.mask    = get_int32( &_header[_extra] );
+         mask.green.mask  = get_int32( &_header[_extra + 4] );
+         mask.blue.mask   = get_int32( &_header[_extra + 8] );
 
          mask.red.width   = count_ones( mask.red.mask   );
          mask.green.width = count_ones( mask.green.mask );
@@ -422,15 +821,15 @@ public:
             }
 	      }
       }
-      else
+      else if( _info_header.what != ct_rle8 && _info_header.what != ct_rle4 )
       {
 	      io_error( "bmp_reader::apply(): unsupported BMP compression" );
       }
+   }
 
-      // Read the color map.
-
-		std::vector<color_map> palette;
-
+   /// Reads the color map following the color masks
+   void read_palette( std::vector<color_map>& palette ) const
+   {
       if( _info_header.bpp <= 8 )
       {
 	      int entries = _info_header.colors;
@@ -442,22 +841,23 @@ public:
 
          palette.resize( entries );
 
-	      for( int i = 0; i < entries; ++i )
+         // entries past the headers read by init() are black
+         std::size_t at = _extra + ( _info_header.what == ct_bitfield ? 12 : 0 );
+
+	      for( int i = 0; i < entries; ++i, at += _info_header.entry )
 	      {
-		      palette[i].blue  = read_int8();
-		      palette[i].green = read_int8();
-		      palette[i].red   = read_int8();
-
-		      if( _info_header.entry > 3 )
-		      {
-			      read_int8();
-		      }
+		      const byte_t* e = ( at + 3 <= _header.size() ) ? &_header[at] : 0;
+
+		      palette[i].blue  = e ? e[0] : 0;
+		      palette[i].green = e ? e[1] : 0;
+		      palette[i].red   = e ? e[2] : 0;
 	      }
       }
+   }
 
-      seek(_file_header.offset);
-
-      // the row pitch must be multiple 4 bytes
+   /// Size of a raster row in bytes, the row pitch must be multiple 4 bytes
+   int get_pitch() const
+   {
       int pitch;
 
       if (_info_header.bpp < 8) {
@@ -466,22 +866,249 @@ public:
       else {
 	      pitch = _info_header.width * ((_info_header.bpp + 7) >> 3);
       }
-      pitch = (pitch + 3) & ~3;
+      return (pitch + 3) & ~3;
+   }
+
+   /// Decodes an RLE4 or RLE8 raster straight into the view rows
+   template <typename VIEW>
+   void read_rle( const VIEW& view, const std::vector<color_map>& palette )
+   {
+      typedef typename VIEW::color_space_t::base Spc;
+      typedef typename VIEW::pixel_t             pixel_t;
+      typedef typename VIEW::x_iterator          iterator_t;
+
+      io_error_if( _info_header.bpp != ( _info_header.what == ct_rle4 ? 4 : 8 )
+                 , "bmp_reader::apply(): invalid bits per pixel for RLE compression" );
+      io_error_if( _info_header.height < 0
+                 , "bmp_reader::apply(): RLE compressed BMP files must be bottom-up" );
+
+      const bool rle4   = ( _info_header.what == ct_rle4 );
+      const int  width  = _info_header.width;
+      const int  height = _info_header.height;
+
+      // converted palette; skipped pixels get the first entry
+      palette_lut<VIEW, Spc> lut( palette, _info_header.bpp );
+
+      rle_source in( device() );
+
+      int x = 0;
+      int y = 0;
+
+      while( y < height )
+      {
+         int cnt = in.next();
+         int val = in.next();
+
+         io_error_if( val == EOF, "bmp_reader::apply(): unexpected end of RLE data" );
+
+         // rows are stored bottom-up
+         iterator_t row = view.row_begin( height - 1 - y );
+
+         if( cnt > 0 )
+         {
+            // encoded mode, one index (RLE8) or two alternating indices (RLE4) repeated
+            cnt = std::min( cnt, width - x );
+
+            if( rle4 )
+            {
+               const pixel_t run[2] = { lut[val >> 4], lut[val & 0x0F] };
+
+               for( int i = 0; i < cnt; ++i )
+               {
+                  row[x + i] = run[i & 1];
+               }
+            }
+            else
+            {
+               std::fill( row + x, row + x + cnt, lut[val] );
+            }
+            x += cnt;
+         }
+         else if( val == 0 )
+         {
+            // end of line
+            std::fill( row + x, row + width, lut[0] );
+
+            x = 0;
+            ++y;
+         }
+         else if( val == 1 )
+         {
+            // end of bitmap
+            std::fill( row + x, row + width, lut[0] );
+
+            for( ++y; y < height; ++y )
+            {
+               row = view.row_begin( height - 1 - y );
+               std::fill( row, row + width, lut[0] );
+            }
+         }
+         else if( val == 2 )
+         {
+            // delta, skip dx pixels to the right and dy rows up
+            int dx = in.next();
+            int dy = in.next();
+
+            io_error_if( dy == EOF, "bmp_reader::apply(): unexpected end of RLE data" );
+
+            int nx = std::min( x + dx, width );
+            int ny = std::min( y + dy, height );
+
+            while( y < ny )
+            {
+               std::fill( row + x, row + width, lut[0] );
+
+               x = 0;
+
+               if( ++y < height )
+               {
+                  row = view.row_begin( height - 1 - y );
+               }
+            }
+            if( y < height )
+            {
+               std::fill( row + x, row + nx, lut[0] );
+            }
+            x = nx;
+         }
+         else
+         {
+            // absolute mode, val literal indices padded to 16 bits
+            int bytes = rle4 ? ( val + 1 ) >> 1 : val;
+            int pak   = 0;
+
+            for( int i = 0; i < val; ++i )
+            {
+               int idx;
+
+               if( rle4 )
+               {
+                  if(( i & 1 ) == 0 )
+                  {
+                     pak = in.next();
+                  }
+                  idx = ( i & 1 ) ? ( pak & 0x0F ) : ( pak >> 4 );
+               }
+               else
+               {
+                  idx = in.next();
+               }
+
+               io_error_if( idx < 0, "bmp_reader::apply(): unexpected end of RLE data" );
+
+               if( x < width )
+               {
+                  row[x++] = lut[idx];
+               }
+            }
+
+            if( bytes & 1 )
+            {
+               in.next();
+            }
+         }
+      }
+   }
+
+public:
+    bmp_reader(FILE* file)           : file_mgr(file)           { init(); }
+    bmp_reader(const char* filename) : file_mgr(filename, "rb") { init(); }
+    bmp_reader(const wchar_t* filename) : file_mgr(filename, L"rb") { init(); }
+    bmp_reader(const io_device_ptr& dev) : file_mgr(dev)             { init(); }
 
-      // read the raster
-      std::vector<byte_t> row(pitch);
+   template <typename VIEW>
+   void apply( const VIEW& view )
+   {
+      io_error_if( view.dimensions() != get_dimensions()
+                 , "bmp_reader::apply(): input view dimensions do not match the image file");
+
+      apply( view, 0, 0 );
+   }
+
+   /// Reads the region of the image whose top left corner is at (x, y) and whose size is the one of the view.
+   /// Uncompressed files are read only for the rows and the bytes the region covers.
+   template <typename VIEW>
+   void apply( const VIEW& view, int x, int y )
+   {
+      io_error_if( x < 0 || y < 0
+                || x + view.width()  > _info_header.width
+                || y + view.height() > std::abs( _info_header.height )
+                 , "bmp_reader::apply(): region of interest is outside the image" );
+
+      typedef typename VIEW::color_space_t::base Spc;
+
+      // read the color masks
+      color_mask mask;
+      read_color_mask( mask );
+
+      // Read the color map.
+		std::vector<color_map> palette;
+      read_palette( palette );
+
+      seek_raster();
+
+      const int width  = view.width();
+      const int height = view.height();
+
+      if( width == 0 || height == 0 )
+      {
+         return;
+      }
+
+      if( _info_header.what == ct_rle8 || _info_header.what == ct_rle4 )
+      {
+         if( view.dimensions() == get_dimensions() )
+         {
+            read_rle( view, palette );
+            return;
+         }
+
+         // RLE rows have no fixed offsets, decode the whole raster and copy the region
+         typedef typename VIEW::pixel_t pixel_t;
+
+         std::vector<pixel_t> all( std::size_t( _info_header.width ) * _info_header.height );
+         read_rle( interleaved_view( _info_header.width, _info_header.height, &all.front(), _info_header.width * sizeof( pixel_t ))
+                 , palette );
+
+         for( int r = 0; r < height; ++r )
+         {
+            const pixel_t* src = &all.front() + std::size_t( y + r ) * _info_header.width + x;
+            std::copy( src, src + width, view.row_begin( r ));
+         }
+         return;
+      }
+
+      const int  pitch     = get_pitch();
+      const int  total     = std::abs( _info_header.height );
+      const bool bottom_up = _info_header.height > 0;
+      const bool whole     = ( x == 0 && width == _info_header.width );
+
+      // stored bits per pixel, 15 bit pixels take two bytes
+      const int bits  = ( _info_header.bpp < 8 ) ? _info_header.bpp : (( _info_header.bpp + 7 ) >> 3 ) << 3;
+      const int first = ( x * bits ) >> 3;
+      const int span  = ((( x + width ) * bits + 7 ) >> 3 ) - first;
+      const int skip  = (( x * bits ) & 7 ) / bits;
+
+      // read the raster, visiting the rows in file order
+      std::vector<byte_t> row( whole ? pitch : span );
 
       int ybeg = 0;
-      int yend = _info_header.height;
+      int yend = height;
       int yinc = 1;
 
-      if( _info_header.height > 0 )
+      if( bottom_up )
       {
-	      ybeg = _info_header.height - 1;
+	      ybeg = height - 1;
 	      yend = -1;
 	      yinc = -1;
       }
 
+      if( whole && ( y > 0 || height < total ))
+      {
+         io_error_if( seek( boost::uint64_t( _file_header.offset ) + boost::uint64_t( bottom_up ? total - y - height : y ) * pitch ) != 0
+                    , "bmp_reader::apply(): failed to seek to the region of interest" );
+      }
+
 		const color_map *pal = 0;
 
 		if( palette.size() > 0 )
@@ -489,12 +1116,53 @@ public:
 			pal = &palette.front();
 		}
 
-      for( int y = ybeg; y != yend; y += yinc )
+      // indexed rows go through the palette converted once for the whole image,
+      // others through the row conversion picked once for the whole image
+      const bool indexed = _info_header.bpp == 1 || _info_header.bpp == 4 || _info_header.bpp == 8;
+
+      palette_lut<VIEW, Spc> lut( palette, _info_header.bpp );
+
+      typename transfer<VIEW, Spc>::read_fn convert = transfer<VIEW, Spc>::reader( _info_header.bpp, mask );
+
+      // rows stored exactly like the view's are read straight into it, the padding into the row buffer
+      typedef bmp_direct_row<typename VIEW::x_iterator> direct_t;
+
+      const bool        direct = conversion<VIEW>() == io_conversion_none;
+      const std::size_t pixels = direct ? std::size_t( width ) * ( _info_header.bpp >> 3 ) : std::size_t( pitch );
+
+      for( int r = ybeg; r != yend; r += yinc )
       {
-         typedef typename VIEW::color_space_t::base Spc;
+         byte_t* dest = direct ? direct_t::bytes( view.row_begin( r )) : &row.front();
 
-	      read(&row.front(), pitch);
-	      transfer<VIEW, Spc>::convert(_info_header.bpp, &row.front(), view.row_begin(y), _info_header.width, pal, mask);
+         if( whole )
+         {
+            read( dest, pixels );
+
+            if( pixels < std::size_t( pitch ))
+            {
+               read( &row.front(), pitch - pixels );
+            }
+         }
+         else
+         {
+            boost::uint64_t line = bottom_up ? total - 1 - ( y + r ) : y + r;
+
+            io_error_if( read_at( dest, span, boost::uint64_t( _file_header.offset ) + line * pitch + first ) != std::size_t( span )
+                       , "bmp_reader::apply(): failed to read the region of interest" );
+         }
+
+         if( direct )
+         {
+            // already in place
+         }
+         else if( indexed )
+         {
+            lut.read_row( &row.front(), view.row_begin( r ), width, skip );
+         }
+         else
+         {
+            convert( &row.front(), view.row_begin( r ), width, pal, mask );
+         }
       }
     }
     
@@ -504,77 +1172,339 @@ public:
         apply(view(im));
     }
 
+    template <typename IMAGE>
+    void read_image(IMAGE& im, int x, int y, int width, int height) {
+        resize_clobber_image(im,point2<int>(width,height));
+        apply(view(im),x,y);
+    }
+
     point2<int> get_dimensions() const {
-        return point2<int>( _info_header.width,_info_header.height );
+        return point2<int>( _info_header.width, std::abs( _info_header.height ));
+    }
+
+    /// Tells what reading the raster into a VIEW involves beyond copying rows
+    template <typename VIEW>
+    io_conversion conversion() const {
+      typedef typename VIEW::x_iterator iterator_t;
+
+      const int bpp = _info_header.bpp;
+
+      if( _info_header.what != ct_rgb && _info_header.what != ct_bitfield )
+      {
+         return io_conversion_expand;
+      }
+
+      if( bmp_direct_row<iterator_t>::matches( bpp ))
+      {
+         if( bpp != 8 )
+         {
+            return io_conversion_none;
+         }
+
+         std::vector<color_map> palette;
+         read_palette( palette );
+
+         return is_gray_ramp( palette ) ? io_conversion_none : io_conversion_expand;
+      }
+
+      color_mask mask;
+      read_color_mask( mask );
+
+      const int  layout = byte_layout<iterator_t>::value;
+      const bool bgrx   = ( bpp == 32 && is_color_mask( mask, 0xFF0000, 0x00FF00, 0x0000FF ));
+
+      if(( layout == layout_rgb && bpp == 24 ) || (( layout == layout_rgba || layout == layout_bgra ) && bgrx ))
+      {
+         return io_conversion_swizzle;
+      }
+      return io_conversion_expand;
     }
 };
 
+/// Maps a BMP file into memory and exposes its pixel array as a read-only view
+class bmp_mapped_reader : public bmp_reader {
+public:
+    bmp_mapped_reader(const char* filename) : bmp_reader(filename), _map(filename) {
+      io_error_if( _info_header.what != ct_rgb && _info_header.what != ct_bitfield
+                 , "bmp_mapped_reader: compressed BMP files cannot be mapped" );
+
+      color_mask mask;
+      read_color_mask( mask );
+      read_palette( _palette );
+
+      // the raster can only be viewed in place when its bytes are plain BGR(A) or gray
+      if( _info_header.what == ct_bitfield ) {
+         io_error_if( mask.red.mask   != 0xFF0000
+                   || mask.green.mask != 0x00FF00
+                   || mask.blue.mask  != 0x0000FF
+                    , "bmp_mapped_reader: bit fields do not match the BGR layout" );
+      }
+
+      std::size_t raster = std::size_t( get_pitch() ) * std::abs( _info_header.height );
+
+      io_error_if( _file_header.offset < 0 || std::size_t( _file_header.offset ) + raster > _map.size()
+                 , "bmp_mapped_reader: file is too short for its raster" );
+    }
+
+    /// Returns a view over the mapped raster. Bottom-up files are viewed with a negative row stride.
+    template <typename VIEW>
+    VIEW get_view() const {
+      typedef typename VIEW::x_iterator iterator_t;
+
+      BOOST_STATIC_ASSERT(bmp_mapped_support_private<iterator_t>::supported);
+
+      io_error_if( _info_header.bpp != bmp_mapped_support_private<iterator_t>::pixel
+                 , "bmp_mapped_reader: view type does not match the BMP pixel layout" );
+
+      if( _info_header.bpp == 8 ) {
+         // indexed data can only be used directly when the palette is the identity gray ramp
+         io_error_if( !is_gray_ramp( _palette ), "bmp_mapped_reader: palette is not a gray ramp" );
+      }
+
+      int            width  = _info_header.width;
+      int            height = std::abs( _info_header.height );
+      std::ptrdiff_t pitch  = get_pitch();
+      const byte_t*  first  = _map.data() + _file_header.offset;
+
+      if( _info_header.height > 0 ) {
+         // bottom-up, the first row of the view is the last row in the file
+         first += ( height - 1 ) * pitch;
+         pitch  = -pitch;
+      }
+
+      return interleaved_view( width, height, reinterpret_cast<iterator_t>( first ), pitch );
+    }
+
+private:
+    mapped_file            _map;
+    std::vector<color_map> _palette;
+};
+
 class bmp_writer : public file_mgr {
+protected:
+    /// Writes the file and information headers followed by the gray palette of 1 and 8 bit files, in a single write.
+    /// A negative height stores the rows top-down; img is the size of a compressed raster.
+    void write_header(int width, int height, int bpp, int compression, int img) {
+      // compute the file size
+      int ent = 0;
+
+      if (bpp <= 8) {
+	      ent = 1 << bpp;
+      }
+
+      int spn = ((width * bpp + 31) >> 5) << 2;
+      int ofs = header_size + win32_info_size + ent * 4;
+      int siz = ofs + (compression == ct_rle8 ? img : spn * std::abs(height));
+
+      std::vector<byte_t> hdr;
+      hdr.reserve(ofs);
+
+      // the BMP file header
+      put_int16(hdr, bm_signature);
+      put_int32(hdr, siz);
+      put_int16(hdr, 0);
+      put_int16(hdr, 0);
+      put_int32(hdr, ofs);
+
+      // Windows information header
+      put_int32(hdr, win32_info_size);
+      put_int32(hdr, width);
+      put_int32(hdr, height);
+      put_int16(hdr, 1);
+      put_int16(hdr, bpp);
+      put_int32(hdr, compression);
+      put_int32(hdr, img);
+      put_int32(hdr, 0);
+      put_int32(hdr, 0);
+      put_int32(hdr, ent);
+      put_int32(hdr, 0);
+
+      // artificial gray palette from black to white
+      for (int i = 0; i < ent; ++i) {
+	      byte_t y = byte_t(i * 255 / (ent - 1));
+
+	      hdr.push_back(y);
+	      hdr.push_back(y);
+	      hdr.push_back(y);
+	      hdr.push_back(0);
+      }
+
+      io_error_if(write(&hdr.front(), hdr.size()) != hdr.size(), "bmp_writer: failed to write file header");
+    }
+
+    /// Appends a 16 bit little endian integer
+    static void put_int16(std::vector<byte_t>& buf, boost::uint16_t x) {
+      buf.push_back(byte_t(x >> 0));
+      buf.push_back(byte_t(x >> 8));
+    }
+
+    /// Appends a 32 bit little endian integer
+    static void put_int32(std::vector<byte_t>& buf, boost::uint32_t x) {
+      buf.push_back(byte_t(x >>  0));
+      buf.push_back(byte_t(x >>  8));
+      buf.push_back(byte_t(x >> 16));
+      buf.push_back(byte_t(x >> 24));
+    }
+
+    /// Writes len bytes of buf and empties it
+    void flush(const std::vector<byte_t>& buf, std::size_t& len) {
+      io_error_if(len > 0 && write(&buf.front(), len) != len, "bmp_writer::apply(): failed to write raster");
+      len = 0;
+    }
+
 public:
     bmp_writer(FILE* file)           : file_mgr(file)           {}
     bmp_writer(const char* filename) : file_mgr(filename, "wb") {}
     bmp_writer(const wchar_t* filename) : file_mgr(filename, L"wb") {}
+    bmp_writer(const io_device_ptr& dev) : file_mgr(dev)             {}
     
     template <typename VIEW>
     void apply(const VIEW& view) {
+      apply(view, ct_rgb);
+    }
+
+    /// Writes the view uncompressed (ct_rgb) or, for 8 bit views, run-length encoded (ct_rle8)
+    template <typename VIEW>
+    void apply(const VIEW& view, int compression) {
 
       typedef typename VIEW::channel_t           channel_t;
       typedef typename VIEW::color_space_t::base color_space_t;
+      typedef typename VIEW::x_iterator          iterator_t;
 
       // check if supported
       if (bmp_read_write_support_private<channel_t, color_space_t>::channel != 8) {
 	      io_error("Input view type is incompatible with the image type");
       }
 
-      // compute the file size
       int bpp = color_space_t::num_channels * 8;
-      int ent = 0;
 
-      if (bpp <= 8) {
-	      ent = 1 << bpp;
+      if (compression != ct_rgb && (compression != ct_rle8 || bpp != 8)) {
+	      io_error("bmp_writer::apply(): RLE8 compression requires an 8 bit view");
       }
-      int spn = (view.width() * color_space_t::num_channels + 3) & ~3;
-      int ofs = header_size + win32_info_size + ent * 4;
-      int siz = ofs + spn * view.height();
-
-      // write the BMP file header
-      write_int16(bm_signature);
-      write_int32(siz);
-      write_int16(0);
-      write_int16(0);
-      write_int32(ofs);
-
-      // writes Windows information header
-      write_int32( win32_info_size );
-      write_int32(view.width());
-      write_int32(view.height());
-      write_int16(1);
-      write_int16(bpp);
-      write_int32(ct_rgb);
-      write_int32(0);
-      write_int32(0);
-      write_int32(0);
-      write_int32(ent);
-      write_int32(0);
-
-      // writes artificial gray palette
-      for (int i = 0; i < ent; ++i) {
-	      write_int8(i);
-	      write_int8(i);
-	      write_int8(i);
-	      write_int8(0);
+
+      int len = view.width() * color_space_t::num_channels;
+      int spn = (len + 3) & ~3;
+      int img = 0;
+
+      // pick the row conversion once for the whole image
+      typename transfer<VIEW, color_space_t>::write_fn convert = transfer<VIEW, color_space_t>::writer(bpp);
+
+      if (compression == ct_rle8) {
+	      std::vector<byte_t> row(spn);
+	      std::vector<byte_t> rle;
+
+	      // encode up front, the header needs the compressed size
+	      for (int y = view.height() - 1; y >= 0; --y) {
+		      convert(view.row_begin(y), &row.front(), view.width());
+		      encode_rle8(&row.front(), view.width(), rle);
+	      }
+	      rle.push_back(0);
+	      rle.push_back(1);
+
+	      img = rle.size();
+
+	      write_header(view.width(), view.height(), bpp, compression, img);
+	      io_error_if(write(&rle.front(), rle.size()) != rle.size(), "bmp_writer::apply(): failed to write raster");
+	      return;
+      }
+
+      write_header(view.width(), view.height(), bpp, compression, img);
+
+      if (view.height() == 0 || spn == 0) {
+	      return;
       }
 
-      // writes the raster
-      std::vector<byte_t> row(spn);
+      // rows stored like BMP rows without padding are written straight from the view when they are
+      // large, all others are collected in an output buffer flushed a few megabytes at a time
+      const std::size_t chunk  = std::max(std::size_t(spn), std::min(std::size_t(spn) * view.height(), std::size_t(4) << 20));
+      const bool        direct = bmp_direct_row<iterator_t>::matches(bpp) && len == spn;
+      const bool        large  = std::size_t(spn) >= (std::size_t(64) << 10);
+
+      std::vector<byte_t> out(direct && large ? 0 : chunk);
+      std::size_t         pos = 0;
 
       for (int y = view.height() - 1; y >= 0; --y) {
-	      transfer<VIEW, color_space_t>::convert(bpp, view.row_begin(y), &row.front(), view.width());
-	      write(&row.front(), spn);
+	      if (direct && large) {
+		      io_error_if(write(bmp_direct_row<iterator_t>::bytes(view.row_begin(y)), spn) != std::size_t(spn)
+		                , "bmp_writer::apply(): failed to write raster");
+		      continue;
+	      }
+
+	      if (pos + spn > out.size()) {
+		      flush(out, pos);
+	      }
+
+	      byte_t *dest = &out[pos];
+
+	      if (direct) {
+		      memcpy(dest, bmp_direct_row<iterator_t>::bytes(view.row_begin(y)), spn);
+	      }
+	      else {
+		      convert(view.row_begin(y), dest, view.width());
+		      memset(dest + len, 0, spn - len);
+	      }
+	      pos += spn;
       }
+      flush(out, pos);
     }
 };
 
+/// Writes a top-down BMP file one row at a time, from the top row to the bottom row
+template <typename VIEW>
+class bmp_stream_writer : public bmp_writer {
+    typedef typename VIEW::color_space_t::base color_space_t;
+    typedef typename VIEW::x_iterator          iterator_t;
+
+public:
+    template <typename T>
+    bmp_stream_writer(const T* filename, int width, int height)
+    : bmp_writer(filename)
+    , _width(width)
+    , _height(height)
+    , _rows(0)
+    , _row((width * color_space_t::num_channels + 3) & ~3)
+    , _convert(transfer<VIEW, color_space_t>::writer(color_space_t::num_channels * 8)) {
+      io_error_if(width <= 0 || height <= 0, "bmp_stream_writer: invalid image dimensions");
+
+      // a negative height makes the rows follow each other top-down
+      write_header(width, -height, color_space_t::num_channels * 8, ct_rgb, 0);
+    }
+
+    /// Appends the next row, which holds as many pixels as the image is wide
+    void write_row(iterator_t src) {
+      io_error_if(_rows >= _height, "bmp_stream_writer::write_row(): all rows have already been written");
+
+      _convert(src, &_row.front(), _width);
+
+      io_error_if(write(&_row.front(), _row.size()) != _row.size(), "bmp_stream_writer::write_row(): failed to write row");
+      ++_rows;
+    }
+
+    /// Appends all rows of a band as wide as the image
+    void write_rows(const VIEW& band) {
+      io_error_if(band.width() != _width, "bmp_stream_writer::write_rows(): band width does not match the image");
+
+      for (int y = 0; y < band.height(); ++y) {
+        write_row(band.row_begin(y));
+      }
+    }
+
+    /// Checks that every row has been written and flushes the file
+    void finish() {
+      io_error_if(_rows != _height, "bmp_stream_writer::finish(): not all rows have been written");
+      io_error_if(!file_mgr::flush(), "bmp_stream_writer::finish(): failed to write file");
+    }
+
+    int rows_written() const { return _rows; }
+
+private:
+    int                                              _width;
+    int                                              _height;
+    int                                              _rows;
+    std::vector<byte_t>                              _row;
+    typename transfer<VIEW, color_space_t>::write_fn _convert;
+};
+
 } // namespace detail
 
 ADOBE_GIL_NAMESPACE_END
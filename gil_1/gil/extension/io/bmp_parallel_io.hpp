@@ -0,0 +1,324 @@
+/*
+  Copyright 2005-2006 Adobe Systems Incorporated
+  Distributed under the MIT License (see accompanying file LICENSE_1_0_0.txt
+  or a copy at http://opensource.adobe.com/licenses.html)
+*/
+
+/*************************************************************************************************/
+
+#ifndef GIL_BMP_PARALLEL_IO_H
+#define GIL_BMP_PARALLEL_IO_H
+
+/// \file
+/// \brief  Multi-threaded decoding of uncompressed BMP files
+//
+/// \author Christian Henning
+///
+/// \date   2007 \n Last updated February 12, 2007
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <boost/bind.hpp>
+#include <boost/ref.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include "bmp_io.hpp"
+
+ADOBE_GIL_NAMESPACE_BEGIN
+
+/// \brief Time spent on one band of rows by a parallel BMP read
+/// \ingroup BMP_IO
+struct bmp_band_timing {
+    int    first_row;   ///< First view row of the band
+    int    rows;        ///< Number of rows in the band
+    double seconds;     ///< Wall clock time spent reading and converting the band
+};
+
+namespace detail {
+
+/// Decodes the raster of a BMP file in bands of rows, one thread per band.
+/// Uncompressed rows have a fixed pitch, so every band reads its own rows
+/// with positional reads into a private buffer.
+class bmp_parallel_reader : public bmp_reader {
+public:
+    bmp_parallel_reader(const char* filename)    : bmp_reader(filename) {}
+    bmp_parallel_reader(const wchar_t* filename) : bmp_reader(filename) {}
+
+    /// Decodes into view using the given number of threads, zero for one per core.
+    /// The time spent on every band is stored in timings when it is not null.
+    template <typename VIEW>
+    void apply( const VIEW& view, int threads, std::vector<bmp_band_timing>* timings )
+    {
+      io_error_if( view.dimensions() != get_dimensions()
+                 , "bmp_parallel_reader::apply(): input view dimensions do not match the image file");
+
+      typedef typename VIEW::color_space_t::base Spc;
+
+      const int height = view.height();
+
+      if( threads <= 0 )
+      {
+         threads = boost::thread::hardware_concurrency();
+      }
+      threads = std::max( 1, std::min( threads, height ));
+
+      if( timings )
+      {
+         timings->clear();
+      }
+
+      if( _info_header.what == ct_rle8 || _info_header.what == ct_rle4 )
+      {
+         // RLE rows have no fixed offsets, decode on this thread
+         band<VIEW> all = { 0, height, false, now() };
+
+         bmp_reader::apply( view );
+         finish( all, timings );
+         return;
+      }
+
+      color_mask mask;
+      read_color_mask( mask );
+
+      std::vector<color_map> palette;
+      read_palette( palette );
+
+      palette_lut<VIEW, Spc> lut( palette, _info_header.bpp );
+
+      setup<VIEW> s = { view
+                      , get_pitch()
+                      , _info_header.height > 0
+                      , _info_header.bpp == 1 || _info_header.bpp == 4 || _info_header.bpp == 8
+                      , &lut
+                      , transfer<VIEW, Spc>::reader( _info_header.bpp, mask )
+                      , palette.empty() ? 0 : &palette.front()
+                      , mask
+                      };
+
+      std::vector< band<VIEW> > bands( threads );
+
+      for( int i = 0; i < threads; ++i )
+      {
+         bands[i].first  = int( boost::int64_t( height ) * i       / threads );
+         bands[i].last   = int( boost::int64_t( height ) * ( i + 1 ) / threads );
+         bands[i].failed = false;
+      }
+
+      // the first band runs on the calling thread
+      boost::thread_group group;
+
+      try
+      {
+         for( int i = 1; i < threads; ++i )
+         {
+            group.create_thread( boost::bind( &bmp_parallel_reader::decode_band<VIEW>
+                                            , this
+                                            , boost::cref( s )
+                                            , boost::ref( bands[i] )));
+         }
+      }
+      catch( ... )
+      {
+         group.join_all();
+         throw;
+      }
+
+      decode_band( s, bands[0] );
+      group.join_all();
+
+      for( int i = 0; i < threads; ++i )
+      {
+         io_error_if( bands[i].failed, "bmp_parallel_reader::apply(): failed to read the raster" );
+      }
+
+      for( int i = 0; i < threads; ++i )
+      {
+         finish( bands[i], timings );
+      }
+    }
+
+    template <typename IMAGE>
+    void read_image( IMAGE& im, int threads, std::vector<bmp_band_timing>* timings )
+    {
+        resize_clobber_image( im, get_dimensions() );
+        apply( view( im ), threads, timings );
+    }
+
+private:
+    typedef boost::posix_time::ptime ptime;
+
+    /// Everything the bands share, read-only while they run
+    template <typename VIEW> struct setup {
+      typedef typename VIEW::color_space_t::base Spc;
+
+      VIEW                                        view;
+      int                                         pitch;
+      bool                                        bottom_up;
+      bool                                        indexed;
+      const palette_lut<VIEW, Spc>*               lut;
+      typename transfer<VIEW, Spc>::read_fn       convert;
+      const color_map*                            pal;
+      color_mask                                  mask;
+    };
+
+    /// One band of view rows [first, last)
+    template <typename VIEW> struct band {
+      int   first;
+      int   last;
+      bool  failed;
+      ptime start;
+      ptime stop;
+    };
+
+    static ptime now()
+    {
+      return boost::posix_time::microsec_clock::universal_time();
+    }
+
+    template <typename VIEW>
+    static void finish( band<VIEW>& b, std::vector<bmp_band_timing>* timings )
+    {
+      if( b.stop.is_not_a_date_time() )
+      {
+         b.stop = now();
+      }
+
+      if( timings )
+      {
+         bmp_band_timing t = { b.first, b.last - b.first, ( b.stop - b.start ).total_microseconds() / 1e6 };
+         timings->push_back( t );
+      }
+    }
+
+    template <typename VIEW>
+    void decode_band( const setup<VIEW>& s, band<VIEW>& b ) throw()
+    {
+      b.start = now();
+
+      try
+      {
+         const int height = s.view.height();
+         const int width  = s.view.width();
+
+         // read up to about a megabyte of rows at a time
+         const int chunk = std::max( 1, ( 1 << 20 ) / s.pitch );
+
+         std::vector<byte_t> buf( std::size_t( s.pitch ) * std::max( 1, std::min( chunk, b.last - b.first )));
+
+         for( int y0 = b.first; y0 < b.last; y0 += chunk )
+         {
+            int y1 = std::min( y0 + chunk, b.last );
+
+            // the file rows of view rows [y0, y1) are contiguous, in reverse order for bottom-up files
+            int         row   = s.bottom_up ? height - y1 : y0;
+            std::size_t bytes = std::size_t( y1 - y0 ) * s.pitch;
+
+            if( read_at( &buf.front(), bytes, boost::uint64_t( _file_header.offset ) + boost::uint64_t( row ) * s.pitch ) != bytes )
+            {
+               b.failed = true;
+               break;
+            }
+
+            for( int y = y0; y < y1; ++y )
+            {
+               const byte_t* src = &buf.front() + std::size_t( s.bottom_up ? y1 - 1 - y : y - y0 ) * s.pitch;
+
+               if( s.indexed )
+               {
+                  s.lut->read_row( src, s.view.row_begin( y ), width );
+               }
+               else
+               {
+                  s.convert( src, s.view.row_begin( y ), width, s.pal, s.mask );
+               }
+            }
+         }
+      }
+      catch( ... )
+      {
+         b.failed = true;
+      }
+
+      b.stop = now();
+    }
+};
+
+} // namespace detail
+
+/// \brief Loads the image specified by the given bmp image file name into the given view, decoding bands of rows in parallel.
+/// \ingroup BMP_IO
+/// threads is the number of bands and threads to use, zero for one per core. When timings is not null it receives the
+/// wall clock time spent on every band. RLE compressed files are decoded on the calling thread as a single band.
+/// Triggers a compile assert if the view color space and channel depth are not supported by the BMP library or by the I/O extension.
+/// Throws std::ios_base::failure if the file is not a valid BMP file, or if its color space or channel depth are not
+/// compatible with the ones specified by VIEW, or if its dimensions don't match the ones of the view.
+template <typename VIEW>
+inline void bmp_read_view_parallel(const wchar_t* filename,const VIEW& view,int threads=0,std::vector<bmp_band_timing>* timings=0) {
+    BOOST_STATIC_ASSERT(bmp_read_write_support<VIEW>::is_supported);
+
+    detail::bmp_parallel_reader m(filename);
+    m.apply(view,threads,timings);
+}
+
+/// \brief Loads the image specified by the given bmp image file name into the given view, decoding bands of rows in parallel.
+/// \ingroup BMP_IO
+/// threads is the number of bands and threads to use, zero for one per core. When timings is not null it receives the
+/// wall clock time spent on every band. RLE compressed files are decoded on the calling thread as a single band.
+/// Triggers a compile assert if the view color space and channel depth are not supported by the BMP library or by the I/O extension.
+/// Throws std::ios_base::failure if the file is not a valid BMP file, or if its color space or channel depth are not
+/// compatible with the ones specified by VIEW, or if its dimensions don't match the ones of the view.
+template <typename VIEW>
+inline void bmp_read_view_parallel(const char* filename,const VIEW& view,int threads=0,std::vector<bmp_band_timing>* timings=0) {
+    BOOST_STATIC_ASSERT(bmp_read_write_support<VIEW>::is_supported);
+
+    detail::bmp_parallel_reader m(filename);
+    m.apply(view,threads,timings);
+}
+
+/// \brief Loads the image specified by the given bmp image file name into the given view, decoding bands of rows in parallel.
+/// \ingroup BMP_IO
+template <typename VIEW>
+inline void bmp_read_view_parallel(const std::string& filename,const VIEW& view,int threads=0,std::vector<bmp_band_timing>* timings=0) {
+    bmp_read_view_parallel(filename.c_str(),view,threads,timings);
+}
+
+/// \brief Allocates a new image whose dimensions are determined by the given bmp image file, and loads the pixels into it
+/// decoding bands of rows in parallel.
+/// \ingroup BMP_IO
+/// Triggers a compile assert if the image color space or channel depth are not supported by the BMP library or by the I/O extension.
+/// Throws std::ios_base::failure if the file is not a valid BMP file, or if its color space or channel depth are not
+/// compatible with the ones specified by IMAGE
+template <typename IMAGE>
+inline void bmp_read_image_parallel(const wchar_t* filename,IMAGE& im,int threads=0,std::vector<bmp_band_timing>* timings=0) {
+    BOOST_STATIC_ASSERT(bmp_read_write_support<typename IMAGE::view_t>::is_supported);
+
+    detail::bmp_parallel_reader m(filename);
+    m.read_image(im,threads,timings);
+}
+
+/// \brief Allocates a new image whose dimensions are determined by the given bmp image file, and loads the pixels into it
+/// decoding bands of rows in parallel.
+/// \ingroup BMP_IO
+/// Triggers a compile assert if the image color space or channel depth are not supported by the BMP library or by the I/O extension.
+/// Throws std::ios_base::failure if the file is not a valid BMP file, or if its color space or channel depth are not
+/// compatible with the ones specified by IMAGE
+template <typename IMAGE>
+inline void bmp_read_image_parallel(const char* filename,IMAGE& im,int threads=0,std::vector<bmp_band_timing>* timings=0) {
+    BOOST_STATIC_ASSERT(bmp_read_write_support<typename IMAGE::view_t>::is_supported);
+
+    detail::bmp_parallel_reader m(filename);
+    m.read_image(im,threads,timings);
+}
+
+/// \brief Allocates a new image whose dimensions are determined by the given bmp image file, and loads the pixels into it
+/// decoding bands of rows in parallel.
+/// \ingroup BMP_IO
+template <typename IMAGE>
+inline void bmp_read_image_parallel(const std::string& filename,IMAGE& im,int threads=0,std::vector<bmp_band_timing>* timings=0) {
+    bmp_read_image_parallel(filename.c_str(),im,threads,timings);
+}
+
+ADOBE_GIL_NAMESPACE_END
+
+#endif
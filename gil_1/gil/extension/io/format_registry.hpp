@@ -0,0 +1,149 @@
+/*
+  Copyright 2005-2006 Adobe Systems Incorporated
+  Distributed under the MIT License (see accompanying file LICENSE_1_0_0.txt
+  or a copy at http://opensource.adobe.com/licenses.html)
+*/
+
+/*************************************************************************************************/
+
+#ifndef GIL_FORMAT_REGISTRY_H
+#define GIL_FORMAT_REGISTRY_H
+
+/// \file
+/// \brief  Reading run-time instantiated images of any registered file format, told apart by their magic bytes
+//
+/// \author Christian Henning
+///
+/// \date   2007 \n Last updated February 12, 2007
+
+#include <stdio.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "io_device.hpp"
+#include "bmp_dynamic_io.hpp"
+#include "pnm_dynamic_io.hpp"
+
+ADOBE_GIL_NAMESPACE_BEGIN
+
+/// \brief Readers of run-time instantiated images, chosen by the magic bytes a file starts with
+/// \ingroup IO
+/// BMP and PNM (P1 to P7) files are registered from the start; add() registers further formats or replaces the reader
+/// of a known one. The first bytes of a file are read once, and the reader picked by them continues on the same device,
+/// so a file is opened only once and the readers don't probe it again. The reader of the longest matching magic is
+/// used; of equally long ones, the one registered last.
+template <typename Images>
+class image_format_registry {
+public:
+    /// Reads an image from the device, which is positioned after the magic bytes it starts with; returns the conversion
+    /// the read involved
+    typedef io_conversion (*read_fn)(const io_device_ptr& dev, any_image<Images>& img);
+
+    image_format_registry() : _sniff(0) {
+        add("BM", &read_bmp);
+
+        const char* pnm[] = { "P1", "P2", "P3", "P4", "P5", "P6", "P7" };
+
+        for (int i = 0; i < 7; ++i) {
+            add(pnm[i], &read_pnm);
+        }
+    }
+
+    /// Registers the reader of files starting with the given magic bytes
+    void add(const std::string& magic, read_fn fn) {
+        io_error_if(magic.empty(), "image_format_registry::add(): empty magic");
+
+        _formats.push_back(format(magic, fn));
+        _sniff = std::max(_sniff, magic.size());
+    }
+
+    /// Returns the reader of data starting with the given bytes, 0 for unknown data
+    read_fn find(const detail::byte_t* data, std::size_t len) const {
+        const format* best = 0;
+
+        for (typename std::vector<format>::const_iterator it = _formats.begin(); it != _formats.end(); ++it) {
+            if (it->magic.size() <= len && std::equal(it->magic.begin(), it->magic.end(), data)
+             && (!best || it->magic.size() >= best->magic.size())) {
+                best = &*it;
+            }
+        }
+        return best ? best->fn : 0;
+    }
+
+    /// Reads an image of any registered format from the device.
+    /// Throws std::ios_base::failure if the format is unknown or its reader fails.
+    io_conversion read_image(const io_device_ptr& dev, any_image<Images>& img) const {
+        std::vector<detail::byte_t> magic(_sniff);
+
+        magic.resize(dev->read(&magic.front(), magic.size()));
+
+        read_fn fn = magic.empty() ? 0 : find(&magic.front(), magic.size());
+
+        io_error_if(fn == 0, "image_format_registry::read_image(): unknown image file format");
+
+        return fn(io_device_ptr(new detail::prefix_device(dev, magic)), img);
+    }
+
+    /// Reads an image of any registered format from the file.
+    /// Throws std::ios_base::failure if the file can't be opened, its format is unknown or its reader fails.
+    io_conversion read_image(const char* filename, any_image<Images>& img) const {
+        FILE* fp;
+        io_error_if((fp=fopen(filename,"rb"))==NULL, "image_format_registry::read_image(): failed to open file");
+
+        return read_image(io_device_ptr(new detail::stdio_device(fp, true)), img);
+    }
+
+    io_conversion read_image(const std::string& filename, any_image<Images>& img) const {
+        return read_image(filename.c_str(), img);
+    }
+
+private:
+    struct format {
+        format(const std::string& m, read_fn f) : magic(m), fn(f) {}
+
+        std::string magic;
+        read_fn     fn;
+    };
+
+    static io_conversion read_bmp(const io_device_ptr& dev, any_image<Images>& img) {
+        return bmp_read_image(dev, img);
+    }
+
+    static io_conversion read_pnm(const io_device_ptr& dev, any_image<Images>& img) {
+        return pnm_read_image(dev, img);
+    }
+
+    std::vector<format> _formats;
+    std::size_t         _sniff;     ///< longest magic
+};
+
+/// \brief Reads an image file of any format registered by default into a run-time instantiated image
+/// \ingroup IO
+/// The format is told by the magic bytes the file starts with; the image type is selected like bmp_read_image and
+/// pnm_read_image do. Returns the conversion the read involved.
+/// Throws std::ios_base::failure if the format is unknown, or if none of the types in Images are compatible with the
+/// type on disk.
+template <typename Images>
+inline io_conversion read_any_image(const char* filename, any_image<Images>& img) {
+    image_format_registry<Images> registry;
+    return registry.read_image(filename, img);
+}
+
+/// \brief Reads an image file of any format registered by default into a run-time instantiated image
+/// \ingroup IO
+template <typename Images>
+inline io_conversion read_any_image(const std::string& filename, any_image<Images>& img) {
+    return read_any_image(filename.c_str(), img);
+}
+
+/// \brief Reads an image of any format registered by default from the given device into a run-time instantiated image
+/// \ingroup IO
+template <typename Images>
+inline io_conversion read_any_image(const io_device_ptr& dev, any_image<Images>& img) {
+    image_format_registry<Images> registry;
+    return registry.read_image(dev, img);
+}
+
+ADOBE_GIL_NAMESPACE_END
+
+#endif
@@ -0,0 +1,441 @@
+/*
+  Copyright 2005-2006 Adobe Systems Incorporated
+  Distributed under the MIT License (see accompanying file LICENSE_1_0_0.txt
+  or a copy at http://opensource.adobe.com/licenses.html)
+*/
+
+/*************************************************************************************************/
+
+#ifndef GIL_HEADER_INDEX_H
+#define GIL_HEADER_INDEX_H
+
+/// \file
+/// \brief  Reads the headers of many BMP and PNM files in parallel
+//
+/// \author Christian Henning
+///
+/// \date   2007 \n Last updated February 12, 2007
+
+#if defined _WIN32
+	#include <windows.h>
+#else
+	#include <sys/types.h>
+	#include <sys/stat.h>
+	#include <dirent.h>
+#endif
+
+#include <stdio.h>
+#include <limits.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <boost/bind.hpp>
+#include <boost/ref.hpp>
+#include <boost/thread/thread.hpp>
+#include "io_error.hpp"
+#include "bmp_io_private.hpp"
+#include "pnm_io_private.hpp"
+
+ADOBE_GIL_NAMESPACE_BEGIN
+
+/// \brief Image file formats told apart by the header indexer
+/// \ingroup IO
+enum image_file_format {
+    image_format_unknown,   ///< not a supported file, or its header is invalid
+    image_format_bmp,       ///< Windows or OS/2 bitmap
+    image_format_pnm        ///< PBM, PGM, PPM or PAM (P1 to P7)
+};
+
+/// \brief Header fields of one image file
+/// \ingroup IO
+struct image_header_info {
+    std::string       path;         ///< File path as given, or joined with the directory
+    image_file_format format;       ///< image_format_unknown when the header couldn't be read
+    int               width;        ///< Width in pixels
+    int               height;       ///< Height in pixels, always positive
+    int               bpp;          ///< Bits per pixel as stored in the file
+    int               compression;  ///< BMP compression (0 none, 1 RLE8, 2 RLE4, 3 bit fields), 0 for PNM
+    int               colors;       ///< Number of palette entries, 0 without palette
+    long              offset;       ///< Offset of the pixel data from the start of the file
+    int               type;         ///< PNM type 1 to 7, 0 for BMP
+    int               maxval;       ///< PNM maximum sample value, 0 for BMP
+    std::string       error;        ///< Reason the header couldn't be read
+};
+
+namespace detail {
+
+/// Reads header fields from the first bytes of a file
+class header_cursor {
+public:
+    header_cursor(const byte_t* buf, std::size_t len) : _pos(buf), _end(buf + len), _overrun(false) {}
+
+    /// Next byte, or -1 past the end of the buffer
+    int next() {
+        if (_pos == _end) {
+            _overrun = true;
+            return -1;
+        }
+        return *_pos++;
+    }
+
+    boost::uint16_t int16() {
+        int a = next(), b = next();
+        return boost::uint16_t(((b & 0xFF) << 8) | (a & 0xFF));
+    }
+
+    boost::uint32_t int32() {
+        boost::uint32_t a = int16(), b = int16();
+        return (b << 16) | a;
+    }
+
+    /// Next PNM character, comments up to the end of line are skipped
+    int pnm_char() {
+        int ch = next();
+
+        if (ch == '#') {
+            do {
+                ch = next();
+            } while (ch != '\n' && ch != '\r' && ch >= 0);
+        }
+        return ch;
+    }
+
+    /// Next PNM decimal integer, or -1 on error. The single separator after it is consumed.
+    int pnm_int() {
+        int ch;
+
+        do {
+            ch = pnm_char();
+        } while (ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r');
+
+        if (ch < '0' || '9' < ch) {
+            return -1;
+        }
+        int val = 0;
+
+        do {
+            if (val > (INT_MAX - 9) / 10) {
+                return -1;
+            }
+            val = val * 10 + (ch - '0');
+            ch  = pnm_char();
+        } while ('0' <= ch && ch <= '9');
+
+        return val;
+    }
+
+    /// Next PAM header token, empty on error. The single separator after it is consumed.
+    std::string pnm_token() {
+        int ch;
+
+        do {
+            ch = pnm_char();
+        } while (ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r');
+
+        std::string token;
+
+        while (ch > ' ') {
+            token += char(ch);
+            ch = pnm_char();
+        }
+        return token;
+    }
+
+    long consumed(const byte_t* buf) const { return long(_pos - buf); }
+    bool overrun() const                   { return _overrun; }
+
+private:
+    const byte_t* _pos;
+    const byte_t* _end;
+    bool          _overrun;
+};
+
+/// Parses a BMP file and information header, the same way bmp_reader does
+inline const char* parse_bmp_header(header_cursor& in, image_header_info& info) {
+    int  type   = in.int16();
+    long size   = long(in.int32());
+    in.int32(); // reserved bytes
+    info.offset = long(in.int32());
+
+    if (type != bm_signature) {
+        return "not a BMP file";
+    }
+    if (info.offset >= size) {
+        return "invalid BMP file header";
+    }
+
+    int info_size = in.int32();
+
+    if (info_size == win32_info_size) {
+        info.width       = boost::int32_t(in.int32());
+        info.height      = boost::int32_t(in.int32());
+                           in.int16();
+        info.bpp         = in.int16();
+        info.compression = in.int32();
+                           in.int32();
+                           in.int32();
+                           in.int32();
+        info.colors      = in.int32();
+    }
+    else if (info_size == os2_info_size) {
+        info.width       = in.int16();
+        info.height      = in.int16();
+                           in.int16();
+        info.bpp         = in.int16();
+        info.compression = ct_rgb;
+        info.colors      = 0;
+    }
+    else {
+        return "invalid BMP info header";
+    }
+
+    if (info.bpp < 1 || info.bpp > 32) {
+        return "unsupported BMP format";
+    }
+
+    info.height = std::abs(info.height);
+
+    if (info.bpp > 8) {
+        info.colors = 0;
+    }
+    else if (info.colors == 0) {
+        info.colors = 1 << info.bpp;
+    }
+    return 0;
+}
+
+/// Parses the header lines of a PAM file after its signature
+inline const char* parse_pam_header(header_cursor& in, const byte_t* buf, image_header_info& info) {
+    int depth = -1;
+
+    info.width = info.height = info.maxval = -1;
+
+    for (;;) {
+        std::string key = in.pnm_token();
+
+        if      (key == "ENDHDR")   break;
+        else if (key == "WIDTH")    info.width  = in.pnm_int();
+        else if (key == "HEIGHT")   info.height = in.pnm_int();
+        else if (key == "DEPTH")    depth       = in.pnm_int();
+        else if (key == "MAXVAL")   info.maxval = in.pnm_int();
+        else if (key == "TUPLTYPE") in.pnm_token();
+        else if (in.overrun())      return 0;
+        else                        return "unknown PAM header field";
+    }
+
+    if (info.width < 0 || info.height < 0 || info.maxval < 1 || depth < 1) {
+        return "invalid PAM header";
+    }
+
+    info.bpp         = depth * ((info.maxval > 255) ? 16 : 8);
+    info.compression = 0;
+    info.colors      = 0;
+    info.offset      = in.consumed(buf);
+    return 0;
+}
+
+/// Parses a PNM header, the same way pnm_reader does
+inline const char* parse_pnm_header(header_cursor& in, const byte_t* buf, image_header_info& info) {
+    if (in.pnm_char() != 'P') {
+        return "invalid PNM signature";
+    }
+    info.type = in.pnm_char() - '0';
+
+    if (info.type < type_mono_asc || info.type > type_pam) {
+        return "invalid PNM file (supports P1 to P7)";
+    }
+
+    if (info.type == type_pam) {
+        return parse_pam_header(in, buf, info);
+    }
+
+    info.width  = in.pnm_int();
+    info.height = in.pnm_int();
+
+    if (info.type == type_mono_asc || info.type == type_mono_bin) {
+        info.maxval = 1;
+    }
+    else {
+        info.maxval = in.pnm_int();
+    }
+
+    if (info.width < 0 || info.height < 0 || info.maxval < 0) {
+        return "unexpected characters reading decimal digits";
+    }
+
+    // samples above 255 take two bytes
+    int depth = (info.maxval > 255) ? 16 : 8;
+
+    switch (info.type) {
+        case type_mono_asc:                      info.bpp =  8;        break;
+        case type_mono_bin:                      info.bpp =  1;        break;
+        case type_color_asc: case type_color_bin: info.bpp = depth * 3; break;
+        default:                                 info.bpp = depth;     break;
+    }
+
+    info.compression = 0;
+    info.colors      = 0;
+    info.offset      = in.consumed(buf);
+    return 0;
+}
+
+/// Reads the header of one file, growing the amount read only when the header doesn't fit
+inline void read_image_header(image_header_info& info) {
+    info.format = image_format_unknown;
+    info.width  = info.height = info.bpp = info.compression = info.colors = info.type = info.maxval = 0;
+    info.offset = 0;
+    info.error.clear();
+
+    FILE* fp = fopen(info.path.c_str(), "rb");
+
+    if (fp == NULL) {
+        info.error = "failed to open file";
+        return;
+    }
+    boost::shared_ptr<FILE> file(fp, fclose);
+
+    // only the header is wanted, skip the stdio buffer
+    setvbuf(fp, NULL, _IONBF, 0);
+
+    std::vector<byte_t> buf(512);
+    std::size_t         len = fread(&buf.front(), 1, buf.size(), fp);
+
+    for (;;) {
+        header_cursor in(&buf.front(), len);
+        const char*   err;
+
+        if (len >= 2 && buf[0] == 'B' && buf[1] == 'M') {
+            info.format = image_format_bmp;
+            err = parse_bmp_header(in, info);
+        }
+        else if (len >= 2 && buf[0] == 'P' && buf[1] >= '1' && buf[1] <= '7') {
+            info.format = image_format_pnm;
+            err = parse_pnm_header(in, &buf.front(), info);
+        }
+        else {
+            info.format = image_format_unknown;
+            info.error  = "unknown image file format";
+            return;
+        }
+
+        if (in.overrun() && len == buf.size() && buf.size() < (std::size_t(64) << 10)) {
+            // the header runs past what was read, long PNM comments
+            buf.resize(buf.size() * 4);
+            len += fread(&buf[len], 1, buf.size() - len, fp);
+            continue;
+        }
+
+        if (in.overrun()) {
+            err = "unexpected end of file";
+        }
+        if (err) {
+            info.format = image_format_unknown;
+            info.error  = err;
+        }
+        return;
+    }
+}
+
+/// Reads the headers of every stride-th entry starting at first
+inline void read_image_header_stride(std::vector<image_header_info>& infos, std::size_t first, std::size_t stride) {
+    for (std::size_t i = first; i < infos.size(); i += stride) {
+        read_image_header(infos[i]);
+    }
+}
+
+/// Lists the regular files of a directory, sorted by name
+inline std::vector<std::string> list_directory(const std::string& directory) {
+    std::vector<std::string> names;
+    std::string              prefix = directory;
+
+    if (!prefix.empty() && prefix[prefix.size() - 1] != '/' && prefix[prefix.size() - 1] != '\\') {
+        prefix += '/';
+    }
+
+#if defined _WIN32
+    WIN32_FIND_DATAA entry;
+    HANDLE           find = FindFirstFileA((prefix + "*").c_str(), &entry);
+
+    io_error_if(find == INVALID_HANDLE_VALUE, "read_image_headers(): failed to open directory");
+
+    do {
+        if ((entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0) {
+            names.push_back(prefix + entry.cFileName);
+        }
+    } while (FindNextFileA(find, &entry));
+
+    FindClose(find);
+#else
+    DIR* dir = opendir(directory.c_str());
+
+    io_error_if(dir == NULL, "read_image_headers(): failed to open directory");
+
+    while (dirent* entry = readdir(dir)) {
+        std::string path = prefix + entry->d_name;
+        struct stat st;
+
+        if (stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode)) {
+            names.push_back(path);
+        }
+    }
+    closedir(dir);
+#endif
+
+    std::sort(names.begin(), names.end());
+    return names;
+}
+
+} // namespace detail
+
+/// \brief Reads the headers of the given BMP and PNM files, using the given number of threads, zero for one per core.
+/// \ingroup IO
+/// Only the first few hundred bytes of every file are read. Files that can't be opened or aren't valid BMP or PNM files
+/// are reported with format image_format_unknown and the reason in error; they don't stop the others from being read.
+inline std::vector<image_header_info> read_image_headers(const std::vector<std::string>& paths, int threads = 0) {
+    std::vector<image_header_info> infos(paths.size());
+
+    for (std::size_t i = 0; i < paths.size(); ++i) {
+        infos[i].path = paths[i];
+    }
+
+    if (threads <= 0) {
+        threads = boost::thread::hardware_concurrency();
+    }
+    threads = int(std::max<std::size_t>(1, std::min<std::size_t>(threads, paths.size())));
+
+    // the first share runs on the calling thread
+    boost::thread_group group;
+
+    try {
+        for (int t = 1; t < threads; ++t) {
+            group.create_thread(boost::bind(&detail::read_image_header_stride, boost::ref(infos), t, threads));
+        }
+    }
+    catch (...) {
+        group.join_all();
+        throw;
+    }
+
+    detail::read_image_header_stride(infos, 0, threads);
+    group.join_all();
+
+    return infos;
+}
+
+/// \brief Reads the headers of all files in the given directory, using the given number of threads, zero for one per core.
+/// \ingroup IO
+/// Subdirectories are not visited. Files that aren't BMP or PNM files are reported with format image_format_unknown.
+/// Throws std::ios_base::failure if the directory can't be listed.
+inline std::vector<image_header_info> read_image_headers(const std::string& directory, int threads = 0) {
+    return read_image_headers(detail::list_directory(directory), threads);
+}
+
+/// \brief Reads the headers of all files in the given directory, using the given number of threads, zero for one per core.
+/// \ingroup IO
+inline std::vector<image_header_info> read_image_headers(const char* directory, int threads = 0) {
+    return read_image_headers(std::string(directory), threads);
+}
+
+ADOBE_GIL_NAMESPACE_END
+
+#endif
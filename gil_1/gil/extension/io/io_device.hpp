@@ -0,0 +1,304 @@
+/*
+  Copyright 2005-2006 Adobe Systems Incorporated
+  Distributed under the MIT License (see accompanying file LICENSE_1_0_0.txt
+  or a copy at http://opensource.adobe.com/licenses.html)
+*/
+
+/*************************************************************************************************/
+
+#ifndef GIL_IO_DEVICE_H
+#define GIL_IO_DEVICE_H
+
+/// \file
+/// \brief  Memory, memory-mapped and file descriptor devices for the image readers and writers
+//
+/// \author Christian Henning
+///
+/// \date   2007 \n Last updated February 12, 2007
+
+#if defined _WIN32
+	#include <io.h>
+#else
+	#include <sys/types.h>
+	#include <unistd.h>
+#endif
+
+#include <errno.h>
+#include <string.h>
+#include <limits.h>
+#include <algorithm>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include "io_error.hpp"
+#include "mapped_file.hpp"
+
+ADOBE_GIL_NAMESPACE_BEGIN
+
+/// \brief Shared handle of a byte device to read an image from or write it to
+/// \ingroup IO
+typedef boost::shared_ptr<detail::io_device> io_device_ptr;
+
+namespace detail {
+
+/// Reads from a block of memory owned by the caller
+class memory_device : public io_device {
+public:
+    memory_device(const void* data, std::size_t size)
+    : _data(static_cast<const byte_t*>(data)), _size(size), _pos(0) {}
+
+    std::size_t read(void* buf, std::size_t cnt) {
+        std::size_t n = read_at(buf, cnt, _pos);
+        _pos += n;
+        return n;
+    }
+
+    std::size_t read_at(void* buf, std::size_t cnt, boost::uint64_t at) {
+        if (at >= _size) {
+            return 0;
+        }
+        std::size_t n = std::min<std::size_t>(cnt, _size - std::size_t(at));
+
+        memcpy(buf, _data + at, n);
+        return n;
+    }
+
+    std::size_t write(const void* buf, std::size_t cnt) {
+        return 0;
+    }
+
+    bool seek(boost::uint64_t at) {
+        _pos = std::size_t(std::min<boost::uint64_t>(at, _size));
+        return at <= _size;
+    }
+
+protected:
+    void reset(const byte_t* data, std::size_t size) {
+        _data = data;
+        _size = size;
+        _pos  = 0;
+    }
+
+private:
+    const byte_t* _data;
+    std::size_t   _size;
+    std::size_t   _pos;
+};
+
+/// Reads from a memory-mapped file
+class mapped_device : public memory_device {
+public:
+    explicit mapped_device(const char* filename) : memory_device(0, 0), _map(filename) {
+        reset(_map.data(), _map.size());
+    }
+
+private:
+    mapped_file _map;
+};
+
+/// Writes into, and reads from, a byte vector owned by the caller, which grows as needed
+class vector_device : public io_device {
+public:
+    explicit vector_device(std::vector<byte_t>& buf) : _buf(buf), _pos(0) {}
+
+    std::size_t read(void* buf, std::size_t cnt) {
+        std::size_t n = read_at(buf, cnt, _pos);
+        _pos += n;
+        return n;
+    }
+
+    std::size_t read_at(void* buf, std::size_t cnt, boost::uint64_t at) {
+        if (at >= _buf.size()) {
+            return 0;
+        }
+        std::size_t n = std::min<std::size_t>(cnt, _buf.size() - std::size_t(at));
+
+        memcpy(buf, &_buf[std::size_t(at)], n);
+        return n;
+    }
+
+    std::size_t write(const void* buf, std::size_t cnt) {
+        if (_pos + cnt > _buf.size()) {
+            _buf.resize(_pos + cnt);
+        }
+        if (cnt > 0) {
+            memcpy(&_buf[_pos], buf, cnt);
+        }
+        _pos += cnt;
+        return cnt;
+    }
+
+    bool seek(boost::uint64_t at) {
+        _pos = std::size_t(at);
+        return true;
+    }
+
+private:
+    std::vector<byte_t>& _buf;
+    std::size_t          _pos;
+};
+
+/// Reads from and writes to a file descriptor, which stays open. Positional reads use pread(),
+/// so several threads can share the descriptor; read_some() takes what a pipe has ready.
+class fd_device : public io_device {
+public:
+    explicit fd_device(int fd) : _fd(fd) {}
+
+    std::size_t read(void* buf, std::size_t cnt) {
+        std::size_t n = 0;
+
+        while (n < cnt) {
+            std::size_t got = read_some(static_cast<byte_t*>(buf) + n, cnt - n);
+
+            if (got == 0) {
+                break;
+            }
+            n += got;
+        }
+        return n;
+    }
+
+    std::size_t read_some(void* buf, std::size_t cnt) {
+        for (;;) {
+        #if defined _WIN32
+            int got = _read(_fd, buf, unsigned(std::min<std::size_t>(cnt, INT_MAX)));
+        #else
+            ssize_t got = ::read(_fd, buf, cnt);
+        #endif
+
+            if (got >= 0) {
+                return std::size_t(got);
+            }
+            if (errno != EINTR) {
+                return 0;
+            }
+        }
+    }
+
+    std::size_t write(const void* buf, std::size_t cnt) {
+        std::size_t n = 0;
+
+        while (n < cnt) {
+        #if defined _WIN32
+            int put = _write(_fd, static_cast<const byte_t*>(buf) + n, unsigned(std::min<std::size_t>(cnt - n, INT_MAX)));
+        #else
+            ssize_t put = ::write(_fd, static_cast<const byte_t*>(buf) + n, cnt - n);
+        #endif
+
+            if (put < 0 && errno == EINTR) {
+                continue;
+            }
+            if (put <= 0) {
+                break;
+            }
+            n += std::size_t(put);
+        }
+        return n;
+    }
+
+    std::size_t read_at(void* buf, std::size_t cnt, boost::uint64_t at) {
+    #if defined _WIN32
+        return _reader.read_at(reinterpret_cast<HANDLE>(_get_osfhandle(_fd)), buf, cnt, at);
+    #else
+        ssize_t got = pread(_fd, buf, cnt, off_t(at));
+
+        return (got < 0) ? 0 : std::size_t(got);
+    #endif
+    }
+
+    bool seek(boost::uint64_t at) {
+    #if defined _WIN32
+        return _lseeki64(_fd, __int64(at), SEEK_SET) >= 0;
+    #else
+        return lseek(_fd, off_t(at), SEEK_SET) >= 0;
+    #endif
+    }
+
+private:
+    int _fd;
+
+#if defined _WIN32
+    handle_reader _reader;
+#endif
+};
+
+/// Gives back bytes already taken from a device, such as its magic bytes, before reading on from it.
+/// The device is used from where the bytes ended.
+class prefix_device : public io_device {
+public:
+    prefix_device(const io_device_ptr& dev, const std::vector<byte_t>& prefix)
+    : _dev(dev), _prefix(prefix), _pos(0) {}
+
+    std::size_t read(void* buf, std::size_t cnt) {
+        std::size_t n = take(buf, cnt);
+
+        return (n < cnt) ? n + _dev->read(static_cast<byte_t*>(buf) + n, cnt - n) : n;
+    }
+
+    std::size_t read_some(void* buf, std::size_t cnt) {
+        std::size_t n = take(buf, cnt);
+
+        return (n > 0) ? n : _dev->read_some(buf, cnt);
+    }
+
+    std::size_t write(const void* buf, std::size_t cnt) {
+        return 0;
+    }
+
+    std::size_t read_at(void* buf, std::size_t cnt, boost::uint64_t at) {
+        return _dev->read_at(buf, cnt, at);
+    }
+
+    bool seek(boost::uint64_t at) {
+        _pos = _prefix.size();
+        return _dev->seek(at);
+    }
+
+private:
+    std::size_t take(void* buf, std::size_t cnt) {
+        std::size_t n = std::min(cnt, _prefix.size() - _pos);
+
+        if (n > 0) {
+            memcpy(buf, &_prefix[_pos], n);
+            _pos += n;
+        }
+        return n;
+    }
+
+    io_device_ptr       _dev;
+    std::vector<byte_t> _prefix;
+    std::size_t         _pos;
+};
+
+} // namespace detail
+
+/// \brief Device reading an image straight from a block of memory, such as a receive buffer. The memory must
+/// outlive the device.
+/// \ingroup IO
+inline io_device_ptr make_memory_device(const void* data, std::size_t size) {
+    return io_device_ptr(new detail::memory_device(data, size));
+}
+
+/// \brief Device reading an image from a memory-mapped file
+/// \ingroup IO
+/// Throws std::ios_base::failure if the file can't be opened or mapped.
+inline io_device_ptr make_mapped_device(const char* filename) {
+    return io_device_ptr(new detail::mapped_device(filename));
+}
+
+/// \brief Device writing an image into a byte vector, which grows as needed; it can be read back through the
+/// same device type. The vector must outlive the device.
+/// \ingroup IO
+inline io_device_ptr make_vector_device(std::vector<unsigned char>& buf) {
+    return io_device_ptr(new detail::vector_device(buf));
+}
+
+/// \brief Device reading or writing an image through a file descriptor, such as a socket or a pipe. The
+/// descriptor is not closed.
+/// \ingroup IO
+inline io_device_ptr make_fd_device(int fd) {
+    return io_device_ptr(new detail::fd_device(fd));
+}
+
+ADOBE_GIL_NAMESPACE_END
+
+#endif
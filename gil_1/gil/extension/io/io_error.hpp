@@ -17,12 +17,17 @@
 
 #if defined _WIN32
 	#include <malloc.h>
+	#include <io.h>
+	#include <windows.h>
 #elif defined __GNUC__
 	#include <alloca.h>
+	#include <unistd.h>
 #endif
 
 #include <ios>
+#include <stdio.h>
 #include <stdarg.h>
+#include <algorithm>
 
 #include <boost/cstdint.hpp>
 #include <boost/shared_ptr.hpp>
@@ -34,6 +39,14 @@ ADOBE_GIL_NAMESPACE_BEGIN
 inline void io_error(const char* descr) { throw std::ios_base::failure(descr); }
 inline void io_error_if(bool expr, const char* descr="") { if (expr) io_error(descr); }
 
+/// \brief What reading a file into a given image type involves beyond copying rows, from least to most work
+/// \ingroup IO
+enum io_conversion {
+    io_conversion_none    = 0,  ///< rows are stored exactly like the image rows
+    io_conversion_swizzle = 1,  ///< bytes are reordered, such as BGR to RGB, or a constant alpha is filled in
+    io_conversion_expand  = 2   ///< samples are unpacked, rescaled, parsed or looked up in a palette
+};
+
 namespace detail {
 
    typedef unsigned char byte_t;
@@ -46,19 +59,120 @@ namespace detail {
 			enum { size = 1 };
 		};
 
+    /// Byte device under the file readers and writers. Reads block until cnt bytes are in or the device
+    /// ends; read_some() may return fewer, whatever a pipe has ready. read_at() reads at an absolute
+    /// position without moving the device position, so several threads may read through one device.
+    /// Sequential reads must not run at the same time as positional ones.
+    class io_device {
+    public:
+        virtual ~io_device() {}
+
+        virtual std::size_t read(void* buf, std::size_t cnt) = 0;
+        virtual std::size_t write(const void* buf, std::size_t cnt) = 0;
+        virtual std::size_t read_at(void* buf, std::size_t cnt, boost::uint64_t at) = 0;
+        virtual bool        seek(boost::uint64_t at) = 0;
+
+        virtual std::size_t read_some(void* buf, std::size_t cnt) { return read(buf, cnt); }
+        virtual bool        flush() { return true; }
+    };
+
+#if defined _WIN32
+    /// Positional reads of a file handle. ReadFile at an offset moves the file pointer of handles opened
+    /// for synchronous I/O, so the pointer is put back afterwards, under a lock that keeps concurrent
+    /// positional reads from putting back each other's pointer.
+    class handle_reader {
+    public:
+        handle_reader()  { InitializeCriticalSection(&_lock); }
+        ~handle_reader() { DeleteCriticalSection(&_lock); }
+
+        std::size_t read_at(HANDLE file, void* buf, std::size_t cnt, boost::uint64_t at) {
+            OVERLAPPED    pos = { 0 };
+            DWORD         got = 0;
+            LARGE_INTEGER here;
+            LARGE_INTEGER was;
+
+            pos.Offset     = DWORD(at);
+            pos.OffsetHigh = DWORD(at >> 32);
+            here.QuadPart  = 0;
+
+            EnterCriticalSection(&_lock);
+
+            BOOL ok = SetFilePointerEx(file, here, &was, FILE_CURRENT);
+
+            if (ok) {
+                ok = ReadFile(file, buf, DWORD(cnt), &got, &pos);
+                ok = SetFilePointerEx(file, was, NULL, FILE_BEGIN) && ok;
+            }
+
+            LeaveCriticalSection(&_lock);
+
+            return ok ? got : 0;
+        }
+
+    private:
+        handle_reader(const handle_reader&);
+        handle_reader& operator=(const handle_reader&);
+
+        CRITICAL_SECTION _lock;
+    };
+#endif
+
+    /// Device over a stdio stream, closed with the device unless it was handed over by the caller
+    class stdio_device : public io_device {
+    public:
+        stdio_device(FILE* file, bool owned) : _fp(file), _owned(owned) {}
+
+        ~stdio_device() {
+            if (_owned) fclose(_fp);
+        }
+
+        std::size_t read(void* buf, std::size_t cnt)  { return fread(buf, 1, cnt, _fp); }
+        std::size_t write(const void* buf, std::size_t cnt) { return fwrite(buf, 1, cnt, _fp); }
+        bool        flush()                            { return fflush(_fp) == 0; }
+        FILE*       get() const                        { return _fp; }
+
+        bool seek(boost::uint64_t at) {
+        #if defined _WIN32
+            return _fseeki64(_fp, __int64(at), SEEK_SET) == 0;
+        #else
+            return fseeko(_fp, off_t(at), SEEK_SET) == 0;
+        #endif
+        }
+
+        std::size_t read_at(void* buf, std::size_t cnt, boost::uint64_t at) {
+        #if defined _WIN32
+            return _reader.read_at(reinterpret_cast<HANDLE>(_get_osfhandle(_fileno(_fp))), buf, cnt, at);
+        #else
+            ssize_t got = pread(fileno(_fp), buf, cnt, off_t(at));
+
+            return (got < 0) ? 0 : std::size_t(got);
+        #endif
+        }
+
+    private:
+        FILE* _fp;
+        bool  _owned;
+
+    #if defined _WIN32
+        handle_reader _reader;
+    #endif
+    };
+
     class file_mgr {
 
     protected:
 
-        boost::shared_ptr<FILE> _fp;
+        boost::shared_ptr<io_device> _dev;
+
+        file_mgr(FILE* file) : _dev(new stdio_device(file, false)) {}
 
-        struct null_deleter { void operator()(void const*) const {} };
-        file_mgr(FILE* file) : _fp(file, null_deleter()) {}
+        /// Reads from or writes to any device
+        file_mgr(const boost::shared_ptr<io_device>& dev) : _dev(dev) {}
 
         file_mgr(const char* filename, const char* flags) {
             FILE* fp;
             io_error_if((fp=fopen(filename,flags))==NULL, "file_mgr: failed to open file");
-            _fp=boost::shared_ptr<FILE>(fp,fclose);
+            _dev.reset(new stdio_device(fp, true));
         }
 
         file_mgr(const wchar_t* filename, const wchar_t* flags) {
@@ -80,17 +194,19 @@ namespace detail {
                io_error_if((fp=fopen(filename_buf,flags_buf))==NULL, "file_mgr: failed to open file");
             #endif
 
-            _fp=boost::shared_ptr<FILE>(fp,fclose);
+            _dev.reset(new stdio_device(fp, true));
         }
 
 			/// Reads raw byte
 			int read() throw() {
-				return fgetc(_fp.get());
+				byte_t m;
+
+				return (_dev->read(&m, 1) == 1) ? m : EOF;
 			}
 
 			/// Reads number of elements in a buffer
 			template <typename T> size_t read(T *buf, size_t cnt) throw() {
-				return fread(buf, buff_item<T>::size, cnt, _fp.get());
+				return _dev->read(buf, buff_item<T>::size * cnt) / buff_item<T>::size;
 			}
 
 			/// Reads array
@@ -100,7 +216,7 @@ namespace detail {
 
 			/// Writes number of elements from a buffer
 			template <typename T> size_t write(const T *buf, size_t cnt) throw() {
-				return fwrite(buf, buff_item<T>::size, cnt, _fp.get());
+				return _dev->write(buf, buff_item<T>::size * cnt) / buff_item<T>::size;
 			}
 
 			/// Writes array
@@ -108,9 +224,29 @@ namespace detail {
 				return write(buf, N);
 			}
 
+			/// Reads bytes at an absolute position without moving the file pointer.
+			/// Several threads may read through the same file this way.
+			size_t read_at(void *buf, size_t cnt, boost::uint64_t at) throw() {
+				return _dev->read_at(buf, cnt, at);
+			}
+
 			/// Positions the file pointer absolutely
-			long seek(long at) throw() {
-				return fseek(_fp.get(), at, SEEK_SET);
+			long seek(boost::uint64_t at) throw() {
+				return _dev->seek(at) ? 0 : -1;
+			}
+
+			/// Writes buffered bytes through to the device
+			bool flush() throw() {
+				return _dev->flush();
+			}
+
+			/// Little endian integers of a header read in one piece
+			static boost::uint16_t get_int16(const byte_t *p) throw() {
+				return boost::uint16_t((p[1] << 8) | p[0]);
+			}
+
+			static boost::uint32_t get_int32(const byte_t *p) throw() {
+				return (boost::uint32_t(p[3]) << 24) | (p[2] << 16) | (p[1] << 8) | p[0];
 			}
 
 			/// Reads byte
@@ -167,7 +303,25 @@ namespace detail {
 
 			/// Reads ASCII text line
 			char *read_line(char *text, int cnt) throw() {
-				return fgets(text, cnt, _fp.get());
+				int n = 0;
+
+				while (n + 1 < cnt) {
+					int ch = read();
+
+					if (ch == EOF) {
+						break;
+					}
+					text[n++] = char(ch);
+
+					if (ch == '\n') {
+						break;
+					}
+				}
+				if (n == 0) {
+					return 0;
+				}
+				text[n] = 0;
+				return text;
 			}
 
 			/// Reads ASCII text line
@@ -177,16 +331,21 @@ namespace detail {
 
 			/// Prints formatted ASCII text
 			void print_line(const char *fmt, ...) throw() {
+				char    text[256];
 				va_list arg;
 
 				va_start(arg, fmt);
-				vfprintf(_fp.get(), fmt, arg);
+				int n = vsnprintf(text, sizeof(text), fmt, arg);
 				va_end(arg);
+
+				if (n > 0) {
+					write(text, std::min<std::size_t>(n, sizeof(text) - 1));
+				}
 			}
 
 
 		/// Compute the consecutive zero bits on the right
-		template <typename T> inline unsigned trailing_zeros(T x) throw() {
+		template <typename T> static inline unsigned trailing_zeros(T x) throw() {
 			unsigned n;
 
 			x = ~x & (x - 1);
@@ -200,7 +359,7 @@ namespace detail {
 		}
 
 		/// Counts a bit-set
-		template <typename T> inline unsigned count_ones(T x) throw() {
+		template <typename T> static inline unsigned count_ones(T x) throw() {
 			unsigned n;
 
 			for (n = 0; x; ++n) {
@@ -211,7 +370,13 @@ namespace detail {
 		}
 
     public:
-        FILE* get() { return _fp.get(); }
+        io_device& device() { return *_dev; }
+
+        /// Stream under the device, or null when the device isn't a stdio stream
+        FILE* get() {
+            stdio_device* dev = dynamic_cast<stdio_device*>(_dev.get());
+            return dev ? dev->get() : 0;
+        }
     };
 }
 
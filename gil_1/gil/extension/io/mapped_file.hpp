@@ -0,0 +1,155 @@
+/*
+  Copyright 2005-2006 Adobe Systems Incorporated
+  Distributed under the MIT License (see accompanying file LICENSE_1_0_0.txt
+  or a copy at http://opensource.adobe.com/licenses.html)
+*/
+
+/*************************************************************************************************/
+
+#ifndef GIL_MAPPED_FILE_H
+#define GIL_MAPPED_FILE_H
+
+/// \file
+/// \brief  Memory mapping of whole image files
+//
+/// \author Christian Henning
+///
+/// \date   2007 \n Last updated February 12, 2007
+
+#if defined _WIN32
+	#include <windows.h>
+#else
+	#include <sys/types.h>
+	#include <sys/stat.h>
+	#include <sys/mman.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+#include <cstddef>
+#include <boost/shared_ptr.hpp>
+#include "io_error.hpp"
+
+ADOBE_GIL_NAMESPACE_BEGIN
+
+namespace detail {
+
+/// Maps a whole file into memory. Copies share the same mapping, which is
+/// released when the last copy goes away.
+class mapped_file {
+public:
+	/// Maps an existing file read-only
+	explicit mapped_file(const char* filename) : _map(new mapping()) {
+		_map->open_read(filename);
+	}
+
+	/// Creates (or truncates) the file with the given size and maps it writable
+	mapped_file(const char* filename, std::size_t size) : _map(new mapping()) {
+		_map->open_write(filename, size);
+	}
+
+	const byte_t* data() const { return _map->data; }
+	byte_t*       data()       { return _map->data; }
+	std::size_t   size() const { return _map->size; }
+
+private:
+	struct mapping {
+		byte_t*     data;
+		std::size_t size;
+
+	#if defined _WIN32
+		HANDLE file, section;
+
+		mapping() : data(0), size(0), file(INVALID_HANDLE_VALUE), section(NULL) {}
+
+		~mapping() {
+			if (data)                         UnmapViewOfFile(data);
+			if (section)                      CloseHandle(section);
+			if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+		}
+
+		void open_read(const char* filename) {
+			file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+			io_error_if(file == INVALID_HANDLE_VALUE, "mapped_file: failed to open file");
+
+			LARGE_INTEGER len;
+			io_error_if(!GetFileSizeEx(file, &len), "mapped_file: failed to query file size");
+			size = static_cast<std::size_t>(len.QuadPart);
+
+			map(PAGE_READONLY, FILE_MAP_READ);
+		}
+
+		void open_write(const char* filename, std::size_t len) {
+			file = CreateFileA(filename, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+			io_error_if(file == INVALID_HANDLE_VALUE, "mapped_file: failed to create file");
+			size = len;
+
+			map(PAGE_READWRITE, FILE_MAP_WRITE);
+		}
+
+		void map(DWORD protect, DWORD access) {
+			if (size == 0) {
+				return;
+			}
+			boost::uint64_t len = size;
+
+			section = CreateFileMapping(file, NULL, protect, DWORD(len >> 32), DWORD(len), NULL);
+			io_error_if(section == NULL, "mapped_file: failed to map file");
+
+			data = reinterpret_cast<byte_t*>(MapViewOfFile(section, access, 0, 0, size));
+			io_error_if(data == NULL, "mapped_file: failed to map file");
+		}
+	#else
+		int fd;
+
+		mapping() : data(0), size(0), fd(-1) {}
+
+		~mapping() {
+			if (data)    munmap(data, size);
+			if (fd >= 0) close(fd);
+		}
+
+		void open_read(const char* filename) {
+			fd = ::open(filename, O_RDONLY);
+			io_error_if(fd < 0, "mapped_file: failed to open file");
+
+			struct stat st;
+			io_error_if(fstat(fd, &st) != 0, "mapped_file: failed to query file size");
+			size = static_cast<std::size_t>(st.st_size);
+
+			map(PROT_READ);
+		}
+
+		void open_write(const char* filename, std::size_t len) {
+			fd = ::open(filename, O_RDWR | O_CREAT | O_TRUNC, 0666);
+			io_error_if(fd < 0, "mapped_file: failed to create file");
+			io_error_if(ftruncate(fd, off_t(len)) != 0, "mapped_file: failed to size file");
+			size = len;
+
+			map(PROT_READ | PROT_WRITE);
+		}
+
+		void map(int protect) {
+			if (size == 0) {
+				return;
+			}
+			void* p = mmap(0, size, protect, MAP_SHARED, fd, 0);
+			io_error_if(p == MAP_FAILED, "mapped_file: failed to map file");
+
+			data = reinterpret_cast<byte_t*>(p);
+		}
+	#endif
+
+	private:
+		mapping(const mapping&);
+		mapping& operator=(const mapping&);
+	};
+
+	boost::shared_ptr<mapping> _map;
+};
+
+} // namespace detail
+
+ADOBE_GIL_NAMESPACE_END
+
+#endif
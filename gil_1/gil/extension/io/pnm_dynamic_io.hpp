@@ -52,22 +52,48 @@ namespace detail {
 		int num_channels;
 	};
 
+	/// Checks the PNM format and accepts only image types that read the file with at most the given conversion
+	template <typename R> struct pnm_layout_check {
+		pnm_layout_check(const R& reader, int num_channels, io_conversion most) throw(): _reader(reader), _format(num_channels), _most(most) {
+		}
+
+		template <typename IMG> bool apply() {
+			return _format.template apply<IMG>() && _reader.template conversion<typename IMG::view_t>() <= _most;
+		}
+
+	private:
+		const R&             _reader;
+		pnm_format_check     _format;
+		io_conversion        _most;
+	};
+
 	/// PNM dynamic file reader
 	struct pnm_reader_dynamic: pnm_reader {
 		/// Creates reader from file
 		template <typename T> pnm_reader_dynamic(const T *file): pnm_reader(file) {
 		}
 
-		/// Reads a run-time instantiated image from file
-		template <typename IMG> void read_image(any_image<IMG>& img) {
-			if (!construct_matched(img, pnm_format_check(channels))) {
+		/// Creates reader from device
+		pnm_reader_dynamic(const io_device_ptr& dev): pnm_reader(dev) {
+		}
+
+		/// Reads a run-time instantiated image from file. Among the compatible types, the first one whose memory layout
+		/// needs the least conversion is chosen; returns that conversion.
+		template <typename IMG> io_conversion read_image(any_image<IMG>& img) {
+			io_conversion most = io_conversion_none;
+
+			while (!construct_matched(img, pnm_layout_check<pnm_reader_dynamic>(*this, channels, most))) {
+				if (most == io_conversion_expand) {
 					io_error("No matching image type");
+				}
+				most = io_conversion(most + 1);
 			}
-			else {
-				resize_clobber_image(img, point2<int>(width, height));
-				detail::dynamic_io_fnobj<pnm_read_check, pnm_reader> op(this);
-				apply_operation(view(img), op);
-			}
+
+			resize_clobber_image(img, point2<int>(width, height));
+			detail::dynamic_io_fnobj<pnm_read_check, pnm_reader> op(this);
+			apply_operation(view(img), op);
+
+			return most;
 		}
 	};
 
@@ -89,31 +115,45 @@ namespace detail {
 
 /// \brief reads a PNM image into a run-time instantiated image
 /// \ingroup PNM_IO
-/// Opens the given PNM file name, selects the first type in Images whose color space and channel are compatible to those of the image file
-/// and creates a new image of that type with the dimensions specified by the image file.
+/// Opens the given PNM file name, selects a type in Images whose color space and channel are compatible to those of the image file
+/// and creates a new image of that type with the dimensions specified by the image file. Types whose memory layout matches the file
+/// are preferred, so that rows can be copied as they are; among equally good types the first one is chosen.
+/// Returns the conversion the read involved.
 /// Throws std::ios_base::failure if none of the types in Images are compatible with the type on disk.
 template <typename IMG> 
-inline void pnm_read_image(const wchar_t *file, any_image<IMG>& img) {
+inline io_conversion pnm_read_image(const wchar_t *file, any_image<IMG>& img) {
 	detail::pnm_reader_dynamic m(file);
-	m.read_image(img);
+	return m.read_image(img);
 }
 
 /// \brief reads a PNM image into a run-time instantiated image
 /// \ingroup PNM_IO
-/// Opens the given PNM file name, selects the first type in Images whose color space and channel are compatible to those of the image file
-/// and creates a new image of that type with the dimensions specified by the image file.
+/// Opens the given PNM file name, selects a type in Images whose color space and channel are compatible to those of the image file
+/// and creates a new image of that type with the dimensions specified by the image file. Types whose memory layout matches the file
+/// are preferred, so that rows can be copied as they are; among equally good types the first one is chosen.
+/// Returns the conversion the read involved.
 /// Throws std::ios_base::failure if none of the types in Images are compatible with the type on disk.
 template <typename IMG> 
-inline void pnm_read_image(const char *file, any_image<IMG>& img) {
+inline io_conversion pnm_read_image(const char *file, any_image<IMG>& img) {
 	detail::pnm_reader_dynamic m(file);
-	m.read_image(img);
+	return m.read_image(img);
 }
 
 /// \brief reads a PNM image into a run-time instantiated image
 /// \ingroup PNM_IO
 template <typename IMG> 
-inline void pnm_read_image(const std::string& file, any_image<IMG>& img) {
-	pnm_read_image(file.c_str(), img);
+inline io_conversion pnm_read_image(const std::string& file, any_image<IMG>& img) {
+	return pnm_read_image(file.c_str(), img);
+}
+
+/// \brief reads a PNM image from the given device into a run-time instantiated image
+/// \ingroup PNM_IO
+/// Selects the image type like the file name version does and returns the conversion the read involved.
+/// Throws std::ios_base::failure if none of the types in Images are compatible with the type on disk.
+template <typename IMG> 
+inline io_conversion pnm_read_image(const io_device_ptr& dev, any_image<IMG>& img) {
+	detail::pnm_reader_dynamic m(dev);
+	return m.read_image(img);
 }
 
 /// \brief Saves the currently instantiated view to a pnm file specified by the given pnm image file name.
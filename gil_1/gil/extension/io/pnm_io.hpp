@@ -23,6 +23,7 @@
 #include <boost/static_assert.hpp>
 #include <boost/shared_ptr.hpp>
 #include "io_error.hpp"
+#include "io_device.hpp"
 #include "pnm_io_private.hpp"
 
 ADOBE_GIL_NAMESPACE_BEGIN
@@ -106,7 +107,7 @@ inline void pnm_read_view(const std::string& filename,const VIEW& view) {
 /// compatible with the ones specified by IMAGE
 template <typename IMAGE>
 inline void pnm_read_image(const wchar_t* filename,IMAGE& im) {
-   BOOST_STATIC_ASSERT(pnm_read_write_support<IMAGE::view_t>::is_supported);
+   BOOST_STATIC_ASSERT(pnm_read_write_support<typename IMAGE::view_t>::is_supported);
 
     detail::pnm_reader m(filename);
     m.read_image(im);
@@ -119,7 +120,7 @@ inline void pnm_read_image(const wchar_t* filename,IMAGE& im) {
 /// compatible with the ones specified by IMAGE
 template <typename IMAGE>
 inline void pnm_read_image(const char* filename,IMAGE& im) {
-   BOOST_STATIC_ASSERT(pnm_read_write_support<IMAGE::view_t>::is_supported);
+   BOOST_STATIC_ASSERT(pnm_read_write_support<typename IMAGE::view_t>::is_supported);
 
     detail::pnm_reader m(filename);
     m.read_image(im);
@@ -135,6 +136,7 @@ inline void pnm_read_image(const std::string& filename,IMAGE& im) {
 /// \brief Saves the view to a pnm file specified by the given pnm image file name.
 /// \ingroup PNM_IO
 /// Triggers a compile assert if the view color space and channel depth are not supported by the pnm library or by the I/O extension.
+/// Views with 16 bit channels are written with the maximum value 65535.
 /// Throws std::ios_base::failure if it fails to create the file.
 template <typename VIEW>
 inline void pnm_write_view(const wchar_t* filename,const VIEW& view ) {
@@ -147,6 +149,7 @@ inline void pnm_write_view(const wchar_t* filename,const VIEW& view ) {
 /// \brief Saves the view to a pnm file specified by the given pnm image file name.
 /// \ingroup PNM_IO
 /// Triggers a compile assert if the view color space and channel depth are not supported by the pnm library or by the I/O extension.
+/// Views with 16 bit channels are written with the maximum value 65535.
 /// Throws std::ios_base::failure if it fails to create the file.
 template <typename VIEW>
 inline void pnm_write_view(const char* filename,const VIEW& view ) {
@@ -163,6 +166,130 @@ inline void pnm_write_view(const std::string& filename,const VIEW& view ) {
     pnm_write_view(filename.c_str(),view);
 }
 
+/// \brief Saves the view to a PAM (P7) file specified by the given image file name, keeping the alpha channel.
+/// \ingroup PNM_IO
+/// The tuple type is GRAYSCALE, RGB or RGB_ALPHA after the view color space. Rows of 8 bit views whose channels are
+/// stored in file order are written straight from the view.
+/// Triggers a compile assert if the view color space and channel depth are not supported by the pnm library or by the I/O extension.
+/// Throws std::ios_base::failure if it fails to create the file.
+template <typename VIEW>
+inline void pam_write_view(const wchar_t* filename,const VIEW& view ) {
+    BOOST_STATIC_ASSERT(pnm_read_write_support<VIEW>::is_supported);
+
+    detail::pnm_writer m(filename);
+    m.apply_pam(view);
+}
+
+/// \brief Saves the view to a PAM (P7) file specified by the given image file name, keeping the alpha channel.
+/// \ingroup PNM_IO
+/// The tuple type is GRAYSCALE, RGB or RGB_ALPHA after the view color space. Rows of 8 bit views whose channels are
+/// stored in file order are written straight from the view.
+/// Triggers a compile assert if the view color space and channel depth are not supported by the pnm library or by the I/O extension.
+/// Throws std::ios_base::failure if it fails to create the file.
+template <typename VIEW>
+inline void pam_write_view(const char* filename,const VIEW& view ) {
+    BOOST_STATIC_ASSERT(pnm_read_write_support<VIEW>::is_supported);
+
+    detail::pnm_writer m(filename);
+    m.apply_pam(view);
+}
+
+/// \brief Saves the view to a PAM (P7) file specified by the given image file name, keeping the alpha channel.
+/// \ingroup PNM_IO
+template <typename VIEW>
+inline void pam_write_view(const std::string& filename,const VIEW& view ) {
+    pam_write_view(filename.c_str(),view);
+}
+
+/// \brief Loads a pnm image from the given device, such as a receive buffer, into the given view.
+/// \ingroup PNM_IO
+/// Triggers a compile assert if the view color space and channel depth are not supported by the PNM library or by the I/O extension.
+/// Throws std::ios_base::failure if the data is not a valid PNM file, or if its color space or channel depth are not
+/// compatible with the ones specified by VIEW, or if its dimensions don't match the ones of the view.
+template <typename VIEW>
+inline void pnm_read_view(const io_device_ptr& dev,const VIEW& view) {
+    BOOST_STATIC_ASSERT(pnm_read_write_support<VIEW>::is_supported);
+
+    detail::pnm_reader m(dev);
+    m.apply(view);
+}
+
+/// \brief Allocates a new image whose dimensions are determined by the pnm image read from the given device, and loads the pixels into it.
+/// \ingroup PNM_IO
+/// Triggers a compile assert if the image color space or channel depth are not supported by the PNM library or by the I/O extension.
+/// Throws std::ios_base::failure if the data is not a valid PNM file, or if its color space or channel depth are not
+/// compatible with the ones specified by IMAGE
+template <typename IMAGE>
+inline void pnm_read_image(const io_device_ptr& dev,IMAGE& im) {
+   BOOST_STATIC_ASSERT(pnm_read_write_support<typename IMAGE::view_t>::is_supported);
+
+    detail::pnm_reader m(dev);
+    m.read_image(im);
+}
+
+/// \brief Saves the view as a pnm image to the given device.
+/// \ingroup PNM_IO
+/// Triggers a compile assert if the view color space and channel depth are not supported by the pnm library or by the I/O extension.
+template <typename VIEW>
+inline void pnm_write_view(const io_device_ptr& dev,const VIEW& view ) {
+    BOOST_STATIC_ASSERT(pnm_read_write_support<VIEW>::is_supported);
+
+    detail::pnm_writer m(dev);
+    m.apply(view);
+}
+
+/// \brief Memory-maps a binary PNM file and gives read-only access to its pixels without decoding or copying them.
+/// \ingroup PNM_IO
+/// VIEW must be gray8c_view_t, rgb8c_view_t or rgba8c_view_t and match a P5, P6 or PAM file of maximum value 255
+/// with as many channels. The view stays valid as long as this object, or a copy of it, is alive.
+/// Throws std::ios_base::failure if the file is not a valid PNM file or its layout doesn't match VIEW.
+template <typename VIEW>
+class pnm_mapped_image {
+public:
+    typedef VIEW view_t;
+
+    explicit pnm_mapped_image(const char* filename)
+    : _reader(filename)
+    , _view(_reader.get_view<VIEW>()) {}
+
+    explicit pnm_mapped_image(const std::string& filename)
+    : _reader(filename.c_str())
+    , _view(_reader.get_view<VIEW>()) {}
+
+    const view_t& view() const { return _view; }
+
+    point2<int> dimensions() const { return _view.dimensions(); }
+
+private:
+    detail::pnm_mapped_reader _reader;
+    view_t                    _view;
+};
+
+/// \brief Creates a binary PNM file of the given dimensions and memory-maps it, so the pixels are rendered straight into the file.
+/// \ingroup PNM_IO
+/// VIEW must be gray8_view_t or rgb8_view_t, which make P5 and P6 files, or rgba8_view_t, which makes a PAM file; the
+/// maximum value is 255. The header is in place on construction and the raster is complete once this object, and every
+/// copy of it, is gone. The pixels start out black (and transparent).
+/// Throws std::ios_base::failure if it fails to create or map the file.
+template <typename VIEW>
+class pnm_mapped_writer {
+public:
+    typedef VIEW view_t;
+
+    pnm_mapped_writer(const char* filename, int width, int height)
+    : _writer(filename, width, height) {}
+
+    pnm_mapped_writer(const std::string& filename, int width, int height)
+    : _writer(filename.c_str(), width, height) {}
+
+    const view_t& view() const { return _writer.get_view(); }
+
+    point2<int> dimensions() const { return view().dimensions(); }
+
+private:
+    detail::pnm_mapped_writer<VIEW> _writer;
+};
+
 ADOBE_GIL_NAMESPACE_END
 
 #endif
@@ -18,11 +18,18 @@
 /// \date   2005-2007 \n Last updated January 24, 2007
 
 #include <stdio.h>
+#include <errno.h>
 #include <boost/static_assert.hpp>
 #include <boost/scoped_array.hpp>
+#include <boost/type_traits/remove_const.hpp>
 #include <vector>
+#include <string>
+#include <algorithm>
 #include "../../core/gil_all.hpp"
 #include "io_error.hpp"
+#include "io_device.hpp"
+#include "row_convert.hpp"
+#include "mapped_file.hpp"
 
 ADOBE_GIL_NAMESPACE_BEGIN
 
@@ -34,7 +41,8 @@ enum {
 	type_color_asc	= 3,	///< sRGB color ASCII encoding
 	type_mono_bin	= 4,	///< Monochrome binary encoding
 	type_gray_bin	= 5,	///< Gray level binary encoding
-	type_color_bin	= 6		///< sRGB color binary encoding
+	type_color_bin	= 6,	///< sRGB color binary encoding
+	type_pam		= 7		///< Portable arbitrary map, binary with optional alpha
 };
 
 /// Determines whether the given channel width and color space are supported for reading and writing
@@ -70,6 +78,30 @@ template <> struct pnm_read_write_support_private<bits8, rgba_t> {
 		pixel		= 32
 	};
 };
+template <> struct pnm_read_write_support_private<bits16, gray_t> {
+	enum {
+		supported	= true,
+		channels	= 1,
+		channel		= 16,
+		pixel		= 16
+	};
+};
+template <> struct pnm_read_write_support_private<bits16, rgb_t> {
+	enum {
+		supported	= true,
+		channels	= 3,
+		channel		= 16,
+		pixel		= 48
+	};
+};
+template <> struct pnm_read_write_support_private<bits16, rgba_t> {
+	enum {
+		supported	= true,
+		channels	= 4,
+		channel		= 16,
+		pixel		= 64
+	};
+};
 
 /// Determines whether the given view type is supported for reading
 template <typename V> struct pnm_read_support {
@@ -94,96 +126,698 @@ template <typename V> struct pnm_write_support {
 };
 
 
+/// Maps file samples to channel values, built once per image. One byte samples are looked up in a
+/// 256 entry table, two byte samples in a 65536 entry one. Two byte samples above the maximum value
+/// are clamped to it. Plain bitmaps (one byte samples of maximum value 1) are negative.
+template <typename Chn> class pnm_rescale {
+public:
+	pnm_rescale(bool negative, int maxv, bool wide) : _maxv(maxv), _identity(true) {
+		const boost::uint32_t maxp = std::numeric_limits<Chn>::max();
+
+		_table.resize(wide ? 0x10000 : 0x100);
+
+		for (boost::uint32_t v = 0; v < _table.size(); ++v) {
+			Chn c;
+
+			if (wide) {
+				c = Chn(std::min<boost::uint32_t>(v, maxv) * maxp / maxv);
+			}
+			else if (negative) {
+				c = Chn((1 - int(v)) * int(maxp));
+			}
+			else {
+				c = Chn(v * maxp / maxv);
+			}
+
+			_table[v]  = c;
+			_identity &= (c == v);
+		}
+	}
+
+	/// Channel value of one byte samples
+	Chn operator()(const byte_t *src) const throw() {
+		return _table[*src];
+	}
+
+	/// Channel value of two byte big endian samples
+	Chn wide(const byte_t *src) const throw() {
+		return _table[(src[0] << 8) | src[1]];
+	}
+
+	const Chn* table() const { return &_table.front(); }
+	int maxv() const         { return _maxv; }
+
+	/// Tells whether every sample maps to itself, so rows can be copied
+	bool identity() const    { return _identity; }
+
+private:
+	std::vector<Chn> _table;
+	int              _maxv;
+	bool             _identity;
+};
+
+/// Row conversions that run on a vectorized kernel, a plain copy or a table lookup over all bytes,
+/// chosen by the byte layout of the view.
+template <int Layout> struct pnm_fast_row {
+	/// From PNM to GIL, returns 0 when there is no fast conversion
+	template <typename T> static typename T::read_fn reader(int bpp, int channels, const typename T::rescale_t& scale) throw() {
+		return 0;
+	}
+
+	/// From GIL to PNM, returns 0 when there is no fast conversion
+	template <typename T> static typename T::write_fn writer(int bpp, int channels) throw() {
+		return 0;
+	}
+
+	/// Looks up cnt bytes
+	template <typename T> static void lookup(const byte_t *src, byte_t *dest, int cnt, const typename T::rescale_t& scale) {
+		const typename T::channel_t *table = scale.table();
+
+		for (; cnt > 0; --cnt) {
+			*dest++ = table[*src++];
+		}
+	}
+};
+
+template <> struct pnm_fast_row<layout_gray> : public pnm_fast_row<layout_other> {
+	template <typename T> static typename T::read_fn reader(int bpp, int channels, const typename T::rescale_t& scale) throw() {
+		if (bpp != 8) {
+			return 0;
+		}
+		return scale.identity() ? &read_8<T> : &read_8_lookup<T>;
+	}
+
+	template <typename T> static typename T::write_fn writer(int bpp, int channels) throw() {
+		return (bpp == 8) ? &write_8<typename T::iterator_t> : 0;
+	}
+
+	template <typename T> static void read_8(const byte_t *src, typename T::iterator_t dest, int cnt, const typename T::rescale_t& scale) {
+		memcpy(dest, src, cnt);
+	}
+
+	template <typename T> static void read_8_lookup(const byte_t *src, typename T::iterator_t dest, int cnt, const typename T::rescale_t& scale) {
+		lookup<T>(src, reinterpret_cast<byte_t*>(dest), cnt, scale);
+	}
+
+	template <typename It> static void write_8(It src, byte_t *dest, int cnt) {
+		memcpy(dest, src, cnt);
+	}
+};
+
+template <> struct pnm_fast_row<layout_rgb> : public pnm_fast_row<layout_other> {
+	template <typename T> static typename T::read_fn reader(int bpp, int channels, const typename T::rescale_t& scale) throw() {
+		switch (bpp)
+		{
+		case 8:  return scale.identity() ? &read_8<T> : 0;
+		case 24: return scale.identity() ? &read_24<T> : &read_24_lookup<T>;
+		case 32: return (channels == 4 && scale.identity()) ? &read_32<T> : 0;
+		}
+		return 0;
+	}
+
+	template <typename T> static typename T::write_fn writer(int bpp, int channels) throw() {
+		return (bpp == 24) ? &write_24<typename T::iterator_t> : 0;
+	}
+
+	template <typename T> static void read_8(const byte_t *src, typename T::iterator_t dest, int cnt, const typename T::rescale_t& scale) {
+		get_row_kernels().gray_to_rgb(src, reinterpret_cast<byte_t*>(dest), cnt);
+	}
+
+	template <typename T> static void read_24(const byte_t *src, typename T::iterator_t dest, int cnt, const typename T::rescale_t& scale) {
+		memcpy(dest, src, cnt * 3);
+	}
+
+	template <typename T> static void read_24_lookup(const byte_t *src, typename T::iterator_t dest, int cnt, const typename T::rescale_t& scale) {
+		lookup<T>(src, reinterpret_cast<byte_t*>(dest), cnt * 3, scale);
+	}
+
+	template <typename T> static void read_32(const byte_t *src, typename T::iterator_t dest, int cnt, const typename T::rescale_t& scale) {
+		get_row_kernels().rgba_to_rgb(src, reinterpret_cast<byte_t*>(dest), cnt);
+	}
+
+	template <typename It> static void write_24(It src, byte_t *dest, int cnt) {
+		memcpy(dest, src, cnt * 3);
+	}
+};
+
+template <> struct pnm_fast_row<layout_bgr> : public pnm_fast_row<layout_other> {
+	template <typename T> static typename T::read_fn reader(int bpp, int channels, const typename T::rescale_t& scale) throw() {
+		return (bpp == 24 && scale.identity()) ? &read_24<T> : 0;
+	}
+
+	template <typename T> static typename T::write_fn writer(int bpp, int channels) throw() {
+		return (bpp == 24) ? &write_24<typename T::iterator_t> : 0;
+	}
+
+	template <typename T> static void read_24(const byte_t *src, typename T::iterator_t dest, int cnt, const typename T::rescale_t& scale) {
+		get_row_kernels().swap_rb_24(src, reinterpret_cast<byte_t*>(dest), cnt);
+	}
+
+	template <typename It> static void write_24(It src, byte_t *dest, int cnt) {
+		get_row_kernels().swap_rb_24(reinterpret_cast<const byte_t*>(src), dest, cnt);
+	}
+};
+
+template <> struct pnm_fast_row<layout_rgba> : public pnm_fast_row<layout_other> {
+	template <typename T> static typename T::read_fn reader(int bpp, int channels, const typename T::rescale_t& scale) throw() {
+		switch (bpp)
+		{
+		case 8:  return scale.identity() ? &read_8<T> : 0;
+		case 32: return (channels != 4) ? 0 : scale.identity() ? &read_32<T> : &read_32_lookup<T>;
+		}
+		return 0;
+	}
+
+	template <typename T> static typename T::write_fn writer(int bpp, int channels) throw() {
+		switch (bpp)
+		{
+		case 24: return &write_24<typename T::iterator_t>;
+		case 32: return &write_32<typename T::iterator_t>;
+		}
+		return 0;
+	}
+
+	template <typename T> static void read_8(const byte_t *src, typename T::iterator_t dest, int cnt, const typename T::rescale_t& scale) {
+		get_row_kernels().gray_to_rgba(src, reinterpret_cast<byte_t*>(dest), cnt);
+	}
+
+	template <typename T> static void read_32(const byte_t *src, typename T::iterator_t dest, int cnt, const typename T::rescale_t& scale) {
+		memcpy(dest, src, cnt * 4);
+	}
+
+	template <typename T> static void read_32_lookup(const byte_t *src, typename T::iterator_t dest, int cnt, const typename T::rescale_t& scale) {
+		lookup<T>(src, reinterpret_cast<byte_t*>(dest), cnt * 4, scale);
+	}
+
+	template <typename It> static void write_24(It src, byte_t *dest, int cnt) {
+		get_row_kernels().rgba_to_rgb(reinterpret_cast<const byte_t*>(src), dest, cnt);
+	}
+
+	template <typename It> static void write_32(It src, byte_t *dest, int cnt) {
+		memcpy(dest, src, cnt * 4);
+	}
+};
+
+/// 16 bit samples are big endian in the file, converted by a byte swap or, below the full range, by a
+/// vectorized rescale that doesn't need the table
+template <int Samples> struct pnm_fast_row_16 {
+	template <typename T> static typename T::read_fn reader(int bpp, int channels, const typename T::rescale_t& scale) throw() {
+		if (bpp != Samples * 16 || channels != Samples) {
+			return 0;
+		}
+		return scale.identity() ? &read<T> : &read_scaled<T>;
+	}
+
+	template <typename T> static typename T::write_fn writer(int bpp, int channels) throw() {
+		return (bpp == Samples * 16 && channels == Samples) ? &write<typename T::iterator_t> : 0;
+	}
+
+	template <typename T> static void read(const byte_t *src, typename T::iterator_t dest, int cnt, const typename T::rescale_t& scale) {
+		get_row_kernels().be16_to_native(src, reinterpret_cast<byte_t*>(dest), cnt * Samples);
+	}
+
+	template <typename T> static void read_scaled(const byte_t *src, typename T::iterator_t dest, int cnt, const typename T::rescale_t& scale) {
+		get_row_kernels().scale_be16(src, reinterpret_cast<byte_t*>(dest), cnt * Samples, scale.maxv());
+	}
+
+	template <typename It> static void write(It src, byte_t *dest, int cnt) {
+		get_row_kernels().native_to_be16(reinterpret_cast<const byte_t*>(src), dest, cnt * Samples);
+	}
+};
+
+template <> struct pnm_fast_row<layout_gray16> : public pnm_fast_row_16<1> {};
+template <> struct pnm_fast_row<layout_rgb16>  : public pnm_fast_row_16<3> {};
+template <> struct pnm_fast_row<layout_rgba16> : public pnm_fast_row_16<4> {};
+
+/// Rows whose file bytes are the bytes of the view, so they can be written straight from view memory
+template <typename It> struct pnm_direct_row {
+	static bool matches(int bpp, int channels) throw() {
+		return false;
+	}
+
+	static byte_t *bytes(It src) throw() {
+		return 0;
+	}
+};
+template <typename P> struct pnm_direct_row<P*> {
+	static bool matches(int bpp, int channels) throw() {
+		return (int(byte_layout<P*>::value) == layout_gray && bpp == 8)
+		    || (int(byte_layout<P*>::value) == layout_rgb  && bpp == 24)
+		    || (int(byte_layout<P*>::value) == layout_rgba && bpp == 32 && channels == 4);
+	}
+
+	static const byte_t *bytes(const P *src) throw() {
+		return reinterpret_cast<const byte_t*>(src);
+	}
+
+	/// Rows of mutable views are read into
+	static byte_t *bytes(typename boost::remove_const<P>::type *src) throw() {
+		return reinterpret_cast<byte_t*>(src);
+	}
+};
+
 /// Transfers and converts row of pixels
 template <typename V, typename C> struct transfer_pnm {
 	typedef typename V::x_iterator iterator_t;
 	typedef typename V::pixel_t    pixel_t;
 	typedef typename V::channel_t  channel_t;
+	typedef pnm_rescale<channel_t> rescale_t;
+
+	/// Converts one row from PNM to GIL
+	typedef void (*read_fn)(const byte_t *src, iterator_t dest, int cnt, const rescale_t& scale);
+
+	/// Converts one row from GIL to PNM
+	typedef void (*write_fn)(iterator_t src, byte_t *dest, int cnt);
+
+	/// Selects the row conversion from PNM to GIL, once per image. Samples take bpp / channels bits.
+	static read_fn reader(int bpp, int channels, const rescale_t& scale) throw() {
+		read_fn fn = pnm_fast_row<byte_layout<iterator_t>::value>::template reader<transfer_pnm>(bpp, channels, scale);
+
+		if (fn) {
+			return fn;
+		}
+
+		if (bpp == 1) {
+			return &read_1;
+		}
+
+		const bool wide = (bpp == channels * 16);
+
+		switch (channels)
+		{
+		case 1: return wide ? &read_16 : &read_8;
+		case 2: return wide ? &read_16_16 : &read_8_8;
+		case 3: return wide ? &read_48 : &read_24;
+		case 4: return wide ? &read_64 : &read_32;
+		}
+		return &read_none;
+	}
+
+	/// Selects the row conversion from GIL to PNM, once per image
+	static write_fn writer(int bpp, int channels) throw() {
+		write_fn fn = pnm_fast_row<byte_layout<iterator_t>::value>::template writer<transfer_pnm>(bpp, channels);
+
+		if (fn) {
+			return fn;
+		}
+
+		const bool wide = (bpp == channels * 16);
+
+		switch (channels)
+		{
+		case 1: return wide ? &write_16 : &write_8;
+		case 3: return wide ? &write_48 : &write_24;
+		case 4: return wide ? &write_64 : &write_32;
+		}
+		return &write_none;
+	}
 
 	/// From PNM to GIL
-	static void convert(int bpp, const byte_t *src, iterator_t dest, int cnt, int maxv) throw() {
+	static void convert(int bpp, int channels, const byte_t *src, iterator_t dest, int cnt, const rescale_t& scale) throw() {
+		reader(bpp, channels, scale)(src, dest, cnt, scale);
+	}
+
+	/// From GIL to PNM
+	static void convert(int bpp, int channels, iterator_t src, byte_t *dest, int cnt) throw() {
+		writer(bpp, channels)(src, dest, cnt);
+	}
+
+	static void read_none(const byte_t *src, iterator_t dest, int cnt, const rescale_t& scale) throw() {
+	}
+
+	/// 1 mono negative
+	static void read_1(const byte_t *src, iterator_t dest, int cnt, const rescale_t& scale) throw() {
 		byte_t    pak;
 		channel_t maxp = std::numeric_limits<channel_t>::max();
 
-		switch (bpp)
-		{
-		case 1:
-			// 1 mono negative
-			for (unsigned bit = 0; cnt > 0; --cnt, ++dest) {
-				if (bit == 0) {
-					bit = 8;
-					pak = ~(*src++);
-				}
-				byte_t y = (pak >> --bit) & 0x01;
-
-				*dest = convertor<V, C>::make(y * maxp / maxv);
+		for (unsigned bit = 0; cnt > 0; --cnt, ++dest) {
+			if (bit == 0) {
+				bit = 8;
+				pak = ~(*src++);
 			}
+			byte_t y = (pak >> --bit) & 0x01;
+
+			*dest = convertor<V, C>::make(y * maxp);
+		}
+	}
+
+	/// 8 mono negative, 8 gray
+	static void read_8(const byte_t *src, iterator_t dest, int cnt, const rescale_t& scale) throw() {
+		for (; cnt > 0; --cnt, ++src, ++dest) {
+			*dest = convertor<V, C>::make(scale(src));
+		}
+	}
+
+	/// 8-8 gray alpha
+	static void read_8_8(const byte_t *src, iterator_t dest, int cnt, const rescale_t& scale) throw() {
+		for (; cnt > 0; --cnt, src += 2, ++dest) {
+			channel_t y = scale(src);
+
+			*dest = convertor<V, C>::make(y, y, y, scale(src + 1));
+		}
+	}
+
+	/// 8-8-8 RGB
+	static void read_24(const byte_t *src, iterator_t dest, int cnt, const rescale_t& scale) throw() {
+		for (; cnt > 0; --cnt, src += 3, ++dest) {
+			*dest = convertor<V, C>::make(scale(src), scale(src + 1), scale(src + 2));
+		}
+	}
+
+	/// 8-8-8-8 RGBA
+	static void read_32(const byte_t *src, iterator_t dest, int cnt, const rescale_t& scale) throw() {
+		for (; cnt > 0; --cnt, src += 4, ++dest) {
+			*dest = convertor<V, C>::make(scale(src), scale(src + 1), scale(src + 2), scale(src + 3));
+		}
+	}
+
+	/// 16 gray
+	static void read_16(const byte_t *src, iterator_t dest, int cnt, const rescale_t& scale) throw() {
+		for (; cnt > 0; --cnt, src += 2, ++dest) {
+			*dest = convertor<V, C>::make(scale.wide(src));
+		}
+	}
+
+	/// 16-16 gray alpha
+	static void read_16_16(const byte_t *src, iterator_t dest, int cnt, const rescale_t& scale) throw() {
+		for (; cnt > 0; --cnt, src += 4, ++dest) {
+			channel_t y = scale.wide(src);
+
+			*dest = convertor<V, C>::make(y, y, y, scale.wide(src + 2));
+		}
+	}
+
+	/// 16-16-16 RGB
+	static void read_48(const byte_t *src, iterator_t dest, int cnt, const rescale_t& scale) throw() {
+		for (; cnt > 0; --cnt, src += 6, ++dest) {
+			*dest = convertor<V, C>::make(scale.wide(src), scale.wide(src + 2), scale.wide(src + 4));
+		}
+	}
+
+	/// 16-16-16-16 RGBA
+	static void read_64(const byte_t *src, iterator_t dest, int cnt, const rescale_t& scale) throw() {
+		for (; cnt > 0; --cnt, src += 8, ++dest) {
+			*dest = convertor<V, C>::make(scale.wide(src), scale.wide(src + 2), scale.wide(src + 4), scale.wide(src + 6));
+		}
+	}
+
+	static void write_none(iterator_t src, byte_t *dest, int cnt) throw() {
+	}
+
+	/// 8 gray
+	static void write_8(iterator_t src, byte_t *dest, int cnt) throw() {
+		channel_t r, g, b, a;
+
+		for (; cnt > 0; --cnt, ++src, ++dest) {
+			convertor<V, C>::split(*src, r, g, b, a);
+			*dest = g;
+		}
+	}
+
+	/// 8-8-8 RGB
+	static void write_24(iterator_t src, byte_t *dest, int cnt) throw() {
+		channel_t r, g, b, a;
+
+		for (; cnt > 0; --cnt, ++src) {
+			convertor<V, C>::split(*src, r, g, b, a);
+
+			*dest++ = r;
+			*dest++ = g;
+			*dest++ = b;
+		}
+	}
+
+	/// 16 gray
+	static void write_16(iterator_t src, byte_t *dest, int cnt) throw() {
+		channel_t r, g, b, a;
+
+		for (; cnt > 0; --cnt, ++src, dest += 2) {
+			convertor<V, C>::split(*src, r, g, b, a);
+
+			dest[0] = byte_t(g >> 8);
+			dest[1] = byte_t(g);
+		}
+	}
+
+	/// 16-16-16 RGB
+	static void write_48(iterator_t src, byte_t *dest, int cnt) throw() {
+		channel_t r, g, b, a;
+
+		for (; cnt > 0; --cnt, ++src, dest += 6) {
+			convertor<V, C>::split(*src, r, g, b, a);
+
+			dest[0] = byte_t(r >> 8);
+			dest[1] = byte_t(r);
+			dest[2] = byte_t(g >> 8);
+			dest[3] = byte_t(g);
+			dest[4] = byte_t(b >> 8);
+			dest[5] = byte_t(b);
+		}
+	}
+
+	/// 8-8-8-8 RGBA
+	static void write_32(iterator_t src, byte_t *dest, int cnt) throw() {
+		channel_t r, g, b, a;
+
+		for (; cnt > 0; --cnt, ++src) {
+			convertor<V, C>::split(*src, r, g, b, a);
+
+			*dest++ = r;
+			*dest++ = g;
+			*dest++ = b;
+			*dest++ = a;
+		}
+	}
+
+	/// 16-16-16-16 RGBA
+	static void write_64(iterator_t src, byte_t *dest, int cnt) throw() {
+		channel_t r, g, b, a;
+
+		for (; cnt > 0; --cnt, ++src, dest += 8) {
+			convertor<V, C>::split(*src, r, g, b, a);
+
+			dest[0] = byte_t(r >> 8);
+			dest[1] = byte_t(r);
+			dest[2] = byte_t(g >> 8);
+			dest[3] = byte_t(g);
+			dest[4] = byte_t(b >> 8);
+			dest[5] = byte_t(b);
+			dest[6] = byte_t(a >> 8);
+			dest[7] = byte_t(a);
+		}
+	}
+};
+
+
+
+/// Tells whether ch is white space in PNM files
+inline bool pnm_space(int ch) throw() {
+	return ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r' || ch == '\v' || ch == '\f';
+}
+
+/// Stores sample n of a row, as one byte or, for maximum values above 255, as two big endian bytes
+inline void pnm_store_sample(byte_t *dest, std::size_t n, unsigned val, bool wide) throw() {
+	if (wide) {
+		dest[2 * n]     = byte_t(val >> 8);
+		dest[2 * n + 1] = byte_t(val);
+	}
+	else {
+		dest[n] = byte_t(val);
+	}
+}
+
+/// Parses ASCII samples from [first, last). Each sample is a decimal number followed by one separator
+/// character, or a single digit for plain bitmaps. Stops at a character that is neither a digit nor
+/// white space and sets bad. Stores at most cnt samples in dest, when dest is not null, and returns
+/// the number of samples parsed. Wide samples take two bytes, see pnm_store_sample.
+inline std::size_t pnm_parse_ascii(const byte_t *first, const byte_t *last, bool single, bool wide, byte_t *dest, std::size_t cnt, bool& bad) throw() {
+	std::size_t n = 0;
+
+	bad = false;
+
+	while (first != last) {
+		byte_t ch = *first++;
+
+		if (pnm_space(ch)) {
+			continue;
+		}
+		if (ch < '0' || '9' < ch) {
+			bad = true;
 			break;
+		}
 
-		case 8:
-			// 8 mono negative, 8 gray
-			if (maxv == 1) {
-				for (; cnt > 0; --cnt, ++src, ++dest) {
-					*dest = convertor<V, C>::make((1 - *src) * maxp);
-				}
+		unsigned val = ch - '0';
+
+		if (!single) {
+			while (first != last && '0' <= *first && *first <= '9') {
+				val = val * 10 + (*first++ - '0');
 			}
-			else {
-				for (; cnt > 0; --cnt, ++src, ++dest) {
-					*dest = convertor<V, C>::make(*src * maxp / maxv);
-				}
+			if (first != last) {
+				// the separator
+				++first;
 			}
-			break;
+		}
 
-		case 24:
-			// 8-8-8 RGB
-			for (; cnt > 0; --cnt, ++dest) {
-				byte_t r = *src++ * maxp / maxv;
-				byte_t g = *src++ * maxp / maxv;
-				byte_t b = *src++ * maxp / maxv;
+		if (dest && n < cnt) {
+			pnm_store_sample(dest, n, val, wide);
+		}
+		++n;
+	}
+	return n;
+}
 
-				*dest = convertor<V, C>::make(r, g, b);
-			}
-			break;
+/// Buffered byte source for PNM headers and ASCII rasters
+class pnm_source {
+public:
+	/// A refill takes whatever the device has ready instead of waiting for the whole buffer,
+	/// so a frame coming through a pipe can be decoded as soon as it is complete.
+	pnm_source(io_device& dev) : _dev(dev), _buf(1 << 16), _pos(0), _end(0), _done(0) {}
+
+	/// Returns the next byte or EOF
+	int next() throw() {
+		if (_pos == _end && !fill()) {
+			return EOF;
 		}
+		return _buf[_pos++];
 	}
 
-	/// From GIL to PNM
-	static void convert(int bpp, iterator_t src, byte_t *dest, int cnt) throw() {
-		channel_t r, g, b, a;
+	/// Returns the next byte without consuming it, or EOF
+	int peek() throw() {
+		if (_pos == _end && !fill()) {
+			return EOF;
+		}
+		return _buf[_pos];
+	}
 
-		switch (bpp)
-		{
-		case 8:
-			// 8 gray
-			for (; cnt > 0; --cnt, ++src, ++dest) {
-				convertor<V, C>::split(*src, r, g, b, a);
-				*dest = g;
-			}
-			break;
+	/// Number of bytes consumed since the start of the file
+	std::size_t tell() const throw() {
+		return _done + _pos;
+	}
+
+	/// Reads cnt bytes, first from the buffer and the rest straight from the file
+	std::size_t read(byte_t *dest, std::size_t cnt) throw() {
+		std::size_t n = std::min(cnt, _end - _pos);
+
+		memcpy(dest, &_buf[_pos], n);
+		_pos += n;
 
-		case 24:
-		case 32:
-			// 8-8-8 RGB, 8-8-8-8 RGB*
-			for (; cnt > 0; --cnt, ++src) {
-				convertor<V, C>::split(*src, r, g, b, a);
+		std::size_t direct = (n < cnt) ? _dev.read(dest + n, cnt - n) : 0;
 
-				*dest++ = r;
-				*dest++ = g;
-				*dest++ = b;
+		_done += direct;
+		return n + direct;
+	}
+
+	/// Appends the rest of the file to text
+	void read_rest(std::vector<byte_t>& text) {
+		do {
+			text.insert(text.end(), _buf.begin() + _pos, _buf.begin() + _end);
+			_pos = _end;
+		} while (fill());
+	}
+
+	/// Reads the next ASCII sample. Returns false at the end of the file or on a character
+	/// that is neither a digit nor white space.
+	bool sample(unsigned& val, bool single) throw() {
+		int ch;
+
+		do {
+			ch = next();
+		} while (pnm_space(ch));
+
+		if (ch < '0' || '9' < ch) {
+			return false;
+		}
+		val = ch - '0';
+
+		if (single) {
+			return true;
+		}
+
+		// the remaining digits and the separator
+		for (;;) {
+			ch = next();
+
+			if (ch < '0' || '9' < ch) {
+				return true;
 			}
-			break;
+			val = val * 10 + (ch - '0');
 		}
 	}
-};
 
+private:
+	bool fill() throw() {
+		_done += _end;
+		_pos   = 0;
+		_end   = _dev.read_some(&_buf.front(), _buf.size());
 
+		return _end > 0;
+	}
+
+	io_device&          _dev;
+	std::vector<byte_t> _buf;
+	std::size_t         _pos, _end;
+	std::size_t         _done;	///< bytes before the buffer
+};
+
+/// Determines the channels of binary PNM rasters of maximum value 255 that can be viewed in place through
+/// the given pixel iterator; mutable iterators can also be written through
+template <typename It> struct pnm_mapped_support_private {
+	enum {
+		supported	= false,
+		writable	= false,
+		channels	= 0
+	};
+};
+template <> struct pnm_mapped_support_private<gray8c_ptr_t> {
+	enum {
+		supported	= true,
+		writable	= false,
+		channels	= 1
+	};
+};
+template <> struct pnm_mapped_support_private<rgb8c_ptr_t> {
+	enum {
+		supported	= true,
+		writable	= false,
+		channels	= 3
+	};
+};
+template <> struct pnm_mapped_support_private<rgba8c_ptr_t> {
+	enum {
+		supported	= true,
+		writable	= false,
+		channels	= 4
+	};
+};
+template <> struct pnm_mapped_support_private<gray8_ptr_t> {
+	enum {
+		supported	= true,
+		writable	= true,
+		channels	= 1
+	};
+};
+template <> struct pnm_mapped_support_private<rgb8_ptr_t> {
+	enum {
+		supported	= true,
+		writable	= true,
+		channels	= 3
+	};
+};
+template <> struct pnm_mapped_support_private<rgba8_ptr_t> {
+	enum {
+		supported	= true,
+		writable	= true,
+		channels	= 4
+	};
+};
 
 class pnm_reader : public file_mgr {
 
 public:
-    pnm_reader(FILE* file)           : file_mgr(file)           { init(); }
-    pnm_reader(const char* filename) : file_mgr(filename, "rb") { init(); }
-    pnm_reader(const wchar_t* filename) : file_mgr(filename, L"rb") { init(); }
+    pnm_reader(FILE* file)           : file_mgr(file)          , _in(device()) { init(); }
+    pnm_reader(const char* filename) : file_mgr(filename, "rb"), _in(device()) { init(); }
+    pnm_reader(const wchar_t* filename) : file_mgr(filename, L"rb"), _in(device()) { init(); }
+    pnm_reader(const io_device_ptr& dev) : file_mgr(dev)      , _in(device()) { init(); }
 
    template <typename VIEW>
    void apply( const VIEW& view )
@@ -198,64 +832,124 @@ public:
 		if (view.width() != width || view.height() != height) {
 			io_error("Input view size does not match the image size");
 		}
-		if (pnm_read_write_support_private<channel_t, color_space_t>::channel != 8) {
+		if (pnm_read_write_support_private<channel_t, color_space_t>::channel != 8 &&
+			pnm_read_write_support_private<channel_t, color_space_t>::channel != 16) {
 			io_error("Input view type is incompatible with the image type");
 		}
 
+		// build the sample table once for the whole image
+		pnm_rescale<channel_t> scale(negative(), maxv, wide());
+
+		read_raster(view, scale);
+   }
+
+    template <typename IMAGE>
+    void read_image(IMAGE& im) {
+        resize_clobber_image(im,get_dimensions());
+        apply(view(im));
+    }
+
+    point2<int> get_dimensions() const {
+        return point2<int>( width, height );
+    }
+
+	/// Tells what reading the raster into a VIEW involves beyond copying rows
+	template <typename VIEW>
+	io_conversion conversion() const {
+		typedef typename VIEW::x_iterator iterator_t;
+
+		if (type == type_mono_asc || type == type_gray_asc || type == type_color_asc || negative()
+		 || int(pnm_read_support<VIEW>::num_channels) != channels) {
+			return io_conversion_expand;
+		}
+
+		const int layout = byte_layout<iterator_t>::value;
+
+		if (maxv == 255 && pnm_direct_row<iterator_t>::matches(bpp, channels)) {
+			return io_conversion_none;
+		}
+		if (maxv == 255 && (layout == layout_bgr || layout == layout_bgra)) {
+			return io_conversion_swizzle;
+		}
+		if (maxv == 65535 && pnm_read_support<VIEW>::bit_depth == 16) {
+			// big endian samples
+			return io_conversion_swizzle;
+		}
+		return io_conversion_expand;
+	}
+
+protected:
+	/// Opens a stream of frames without reading a header; init() reads the header of every frame
+	pnm_reader(int fd) : file_mgr(make_fd_device(fd)), _in(device()) {}
+
+	/// Reads the raster into view, which has the image dimensions. Returns false when the file
+	/// ends early or an ASCII raster holds a bad character.
+	template <typename VIEW>
+	bool read_raster(const VIEW& view, const pnm_rescale<typename VIEW::channel_t>& scale) {
+		typedef typename VIEW::color_space_t::base color_space_t;
+
 		// determine the the line pitch
-		int pitch = (bpp == 1) ? (width + 7) >> 3 : width * channels;
+		int pitch = get_pitch();
 
-		// read the raster
-		std::vector<byte_t> row(pitch);
+		// the row buffer is kept from image to image
+		_row.resize(pitch);
+
+		// pick the row conversion once for the whole image
+		typename transfer_pnm<VIEW, color_space_t>::read_fn convert = transfer_pnm<VIEW, color_space_t>::reader(bpp, channels, scale);
 
 		if (type == type_mono_asc || type == type_gray_asc || type == type_color_asc) {
-			char buf[16];
+			unsigned val;
 
 			for (int y = 0; y < height; ++y) {
-				for (int x = 0; x < pitch; ++x) {
+				for (int x = 0; x < width * channels; ++x) {
 					// read the pixel value
-					for (int k = 0; ; ) {
-						int ch = read();
-
-						if (isdigit(ch)) {
-							buf[k++] = ch;
-						}
-						else if (k) {
-							buf[k] = 0;
-							break;
-						}
-						else if (ch == EOF || !isspace(ch)) {
-							return;
-						}
+					if (!_in.sample(val, type == type_mono_asc)) {
+						return false;
 					}
-					row[x] = atoi(buf);
+					pnm_store_sample(&_row.front(), x, val, wide());
 				}
-				transfer_pnm<VIEW, color_space_t>::convert(bpp, &row.front(), view.row_begin(y), width, maxv);
+				convert(&_row.front(), view.row_begin(y), width, scale);
 			}
+			return true;
 		}
-		else {
+
+		bool complete = true;
+
+		if (conversion<VIEW>() == io_conversion_none) {
+			// rows stored exactly like the view's are read straight into it
+			typedef pnm_direct_row<typename VIEW::x_iterator> direct_t;
+
 			for (int y = 0; y < height; ++y) {
-				read(&row.front(), pitch);
-				transfer_pnm<VIEW, color_space_t>::convert(bpp, &row.front(), view.row_begin(y), width, maxv);
+				complete &= (_in.read(direct_t::bytes(view.row_begin(y)), pitch) == std::size_t(pitch));
 			}
+			return complete;
 		}
 
-   }
+		for (int y = 0; y < height; ++y) {
+			complete &= (_in.read(&_row.front(), pitch) == std::size_t(pitch));
+			convert(&_row.front(), view.row_begin(y), width, scale);
+		}
+		return complete;
+	}
 
-    template <typename IMAGE>
-    void read_image(IMAGE& im) {
-        resize_clobber_image(im,get_dimensions());
-        apply(view(im));
-    }
+	/// Tells whether samples take two bytes
+	bool wide() const {
+		return maxv > 255;
+	}
 
-    point2<int> get_dimensions() const {
-        return point2<int>( width, height );
-    }
+	/// Tells whether gray samples of 0 are white, as in bitmaps; PAM black and white samples are positive
+	bool negative() const {
+		return type != type_pam && channels == 1 && maxv == 1;
+	}
+
+	/// Bytes per raster row, ASCII samples are stored as in binary files
+	int get_pitch() const {
+		return (bpp == 1) ? (width + 7) >> 3 : width * channels * (wide() ? 2 : 1);
+	}
 
-protected:
 	/// Read PNM character
-	char read_char(FILE *file) {
-		int ch = getc(file);
+	char read_char() {
+		int ch = _in.next();
 
 		if (ch == EOF) {
 			io_error("Unexpected EOF");
@@ -263,7 +957,7 @@ protected:
 		if (ch == '#') {
 			// skip comment to EOL
 			do {
-				ch = getc(file);
+				ch = _in.next();
 
 				if (ch == EOF) {
 					io_error("Unexpected EOF reading comment");
@@ -274,11 +968,11 @@ protected:
 	}
 
 	/// Read PNM integer
-	unsigned int read_int(FILE *file) {
+	unsigned int read_int() {
 		char ch;
 
 		do {
-			ch = read_char(file);
+			ch = read_char();
 		} while (ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r');
 
 		if (ch < '0' || '9' < ch) {
@@ -294,55 +988,123 @@ protected:
 			}
 			val = val * 10 + dig;
 
-			ch = read_char(file);
+			ch = read_char();
 		} while ('0' <= ch && ch <= '9');
 
 		return val;
 	}
 
+	/// Read PAM header token, the white space after it is consumed
+	std::string read_token() {
+		char ch;
+
+		do {
+			ch = read_char();
+		} while (pnm_space(ch));
+
+		std::string token;
+
+		do {
+			token += ch;
+			ch = read_char();
+		} while (!pnm_space(ch));
+
+		return token;
+	}
+
+	/// Read PAM header lines up to ENDHDR
+	void init_pam() {
+		std::string tuple;
+
+		width = height = channels = maxv = -1;
+
+		for (;;) {
+			std::string key = read_token();
+
+			if      (key == "ENDHDR")   break;
+			else if (key == "WIDTH")    width    = read_int();
+			else if (key == "HEIGHT")   height   = read_int();
+			else if (key == "DEPTH")    channels = read_int();
+			else if (key == "MAXVAL")   maxv     = read_int();
+			else if (key == "TUPLTYPE") tuple    = read_token();
+			else io_error("Unknown PAM header field");
+		}
+
+		if (width < 0 || height < 0 || channels < 0 || maxv < 0) {
+			io_error("Incomplete PAM header");
+		}
+		if (maxv < 1 || maxv > 65535) {
+			io_error("Unsupported PNM format (supports maximum values 1 to 65535)");
+		}
+
+		// the tuple type must agree with the depth, without one the depth decides
+		int depth = channels;
+
+		if      (tuple == "GRAYSCALE" || tuple == "BLACKANDWHITE")             depth = 1;
+		else if (tuple == "GRAYSCALE_ALPHA" || tuple == "BLACKANDWHITE_ALPHA") depth = 2;
+		else if (tuple == "RGB")                                               depth = 3;
+		else if (tuple == "RGB_ALPHA")                                         depth = 4;
+		else if (!tuple.empty())                                               depth = 0;
+
+		if (depth != channels || depth < 1 || depth > 4) {
+			io_error("Unsupported PAM tuple type");
+		}
+		bpp = channels * (wide() ? 16 : 8);
+	}
+
 	/// Read PNM information
 	void init() {
-		FILE *fp = get();
-
 		// read PNM type information
-		if (read_char(fp) != 'P') {
+		if (read_char() != 'P') {
 			io_error("Invalid PNM signature");
 		}
-		type = read_char(fp) - '0';
+		type = read_char() - '0';
 
-		if (type < type_mono_asc || type > type_color_bin) {
-			io_error("Invalid PNM file (supports P1 to P6)");
+		if (type < type_mono_asc || type > type_pam) {
+			io_error("Invalid PNM file (supports P1 to P7)");
+		}
+		if (type == type_pam) {
+			init_pam();
+			return;
 		}
 
 		// get dimensions
-		width  = read_int(fp);
-		height = read_int(fp);
+		width  = read_int();
+		height = read_int();
 
 		// get pixel range
 		if (type == type_mono_asc || type == type_mono_bin) {
 			maxv = 1;
 		}
 		else {
-			maxv = read_int(fp);
+			maxv = read_int();
 
-			if (maxv > 255) {
-				io_error("Unsupported PNM format (supports maximum value 255)");
+			if (maxv < 1 || maxv > 65535) {
+				io_error("Unsupported PNM format (supports maximum values 1 to 65535)");
 			}
 		}
 
-		// determine the channels and BPP
+		// determine the channels and BPP, samples above 255 take two bytes
+		int depth = wide() ? 16 : 8;
+
 		switch (type) {
-			case type_mono_asc:  channels = 1; bpp =  8; break;
-			case type_gray_asc:  channels = 1; bpp =  8; break;
-			case type_color_asc: channels = 3; bpp = 24; break;
+			case type_mono_asc:  channels = 1; bpp =  8;        break;
+			case type_gray_asc:  channels = 1; bpp = depth;     break;
+			case type_color_asc: channels = 3; bpp = depth * 3; break;
 
-			case type_mono_bin:  channels = 1; bpp =  1; break;
-			case type_gray_bin:  channels = 1; bpp =  8; break;
-			case type_color_bin: channels = 3; bpp = 24; break;
+			case type_mono_bin:  channels = 1; bpp =  1;        break;
+			case type_gray_bin:  channels = 1; bpp = depth;     break;
+			case type_color_bin: channels = 3; bpp = depth * 3; break;
 		}
 	}
 
 protected:
+	/// Buffered header and raster bytes
+	pnm_source _in;
+
+	/// One raster row as stored in the file
+	std::vector<byte_t> _row;
+
 	/// Image type and maximum pixel value
 	int type, maxv;
 
@@ -358,41 +1120,154 @@ public:
     pnm_writer(FILE* file)           : file_mgr(file)           {}
     pnm_writer(const char* filename) : file_mgr(filename, "wb") {}
     pnm_writer(const wchar_t* filename) : file_mgr(filename, L"wb") {}
+    pnm_writer(const io_device_ptr& dev) : file_mgr(dev)            {}
 
+    /// Writes a PGM or PPM file, the alpha channel is dropped
     template <typename VIEW>
     void apply(const VIEW& view) {
+      write_raster(view, false);
+    }
+
+    /// Writes a PAM file, which keeps every channel
+    template <typename VIEW>
+    void apply_pam(const VIEW& view) {
+      write_raster(view, true);
+    }
+
+    /// Formats the header of a binary PNM or PAM file
+    static std::string header(int type, int width, int height, int chn, int maxv) {
+      char buf[160];
+
+      if (type == type_pam) {
+	      static const char *tuple[] = { "", "GRAYSCALE", "GRAYSCALE_ALPHA", "RGB", "RGB_ALPHA" };
+
+	      sprintf(buf, "P7\nWIDTH %i\nHEIGHT %i\nDEPTH %i\nMAXVAL %i\nTUPLTYPE %s\nENDHDR\n"
+	             , width, height, chn, maxv, tuple[chn]);
+      }
+      else {
+	      // Add a white space at each string so read_int() can decide when a numbers ends.
+	      // 16 bit channels are written with their full range, as big endian samples.
+	      sprintf(buf, "P%i %i %i %i ", type, width, height, maxv);
+      }
+      return buf;
+    }
+
+private:
+    template <typename VIEW>
+    void write_raster(const VIEW& view, bool pam) {
 
       typedef typename VIEW::channel_t           channel_t;
       typedef typename VIEW::color_space_t::base color_space_t;
+      typedef typename VIEW::x_iterator          iterator_t;
+
+      const int depth = pnm_read_write_support_private<channel_t, color_space_t>::channel;
 
       // check if supported
-      if( pnm_read_write_support_private<channel_t, color_space_t>::channel != 8) {
+      if( depth != 8 && depth != 16) {
 	      io_error("Input view type is incompatible with the image type");
       }
 
 		int width  = view.width();
 		int height = view.height();
-		int chn    = std::min(3, color_space_t::num_channels);
-		int bpp    = chn * 8;
-		int pitch  = chn * width;
+		int chn    = pam ? int(color_space_t::num_channels) : std::min(3, color_space_t::num_channels);
+		int bpp    = chn * depth;
+		int pitch  = chn * width * (depth / 8);
 		int type   = (color_space_t::num_channels == 1) ? type_gray_bin : type_color_bin;
 
-      // Add a white space at each string so read_int() can decide when a numbers ends.
-      print_line("P%i ", type);
-      print_line("%i ", width);
-      print_line("%i ", height);
-      print_line("255 ");
+      std::string hdr = header(pam ? type_pam : type, width, height, chn, (1 << depth) - 1);
+
+      io_error_if(write(hdr.data(), hdr.size()) != hdr.size(), "pnm_writer::apply(): failed to write header");
+
+		// rows stored like file rows are written straight from the view, in one piece when they follow each other
+		if (pnm_direct_row<iterator_t>::matches(bpp, chn)) {
+			const byte_t *first = pnm_direct_row<iterator_t>::bytes(view.row_begin(0));
+			bool          whole = true;
+
+			for (int y = 1; y < height && whole; ++y) {
+				whole = (pnm_direct_row<iterator_t>::bytes(view.row_begin(y)) == first + std::size_t(y) * pitch);
+			}
+
+			if (whole) {
+				io_error_if(write(first, std::size_t(pitch) * height) != std::size_t(pitch) * height
+				          , "pnm_writer::apply(): failed to write raster");
+				return;
+			}
+
+			for (int y = 0; y < height; ++y) {
+				io_error_if(write(pnm_direct_row<iterator_t>::bytes(view.row_begin(y)), pitch) != std::size_t(pitch)
+				          , "pnm_writer::apply(): failed to write raster");
+			}
+			return;
+		}
 
 		// writes the raster
 		std::vector<byte_t> row(pitch);
 
+		// pick the row conversion once for the whole image
+		typename transfer_pnm<VIEW, color_space_t>::write_fn convert = transfer_pnm<VIEW, color_space_t>::writer(bpp, chn);
+
 		for (int y = 0; y < height; ++y) {
-			transfer_pnm<VIEW, color_space_t>::convert(bpp, view.row_begin(y), &row.front(), width);
+			convert(view.row_begin(y), &row.front(), width);
 			write(&row.front(), pitch);
 		}
 	}
 };
 
+/// Maps a binary PNM or PAM file of maximum value 255 into memory and exposes its raster as a read-only view
+class pnm_mapped_reader : public pnm_reader {
+public:
+    pnm_mapped_reader(const char* filename) : pnm_reader(filename), _map(filename), _offset(_in.tell()) {
+      io_error_if( ( type != type_gray_bin && type != type_color_bin && type != type_pam ) || maxv != 255
+                 , "pnm_mapped_reader: only binary files of maximum value 255 can be mapped" );
+
+      io_error_if( _offset + std::size_t( get_pitch() ) * height > _map.size()
+                 , "pnm_mapped_reader: file is too short for its raster" );
+    }
+
+    /// Returns a view over the mapped raster
+    template <typename VIEW>
+    VIEW get_view() const {
+      typedef typename VIEW::x_iterator iterator_t;
+
+      BOOST_STATIC_ASSERT(pnm_mapped_support_private<iterator_t>::supported);
+
+      io_error_if( channels != pnm_mapped_support_private<iterator_t>::channels
+                 , "pnm_mapped_reader: view type does not match the PNM pixel layout" );
+
+      return interleaved_view( width, height, reinterpret_cast<iterator_t>( _map.data() + _offset ), get_pitch() );
+    }
+
+private:
+    mapped_file _map;
+    std::size_t _offset;
+};
+
+/// Creates a binary PNM or PAM file of maximum value 255 with the given dimensions, maps it into memory
+/// and exposes its raster as a mutable view. Gray and RGB views make PGM and PPM files, RGBA views PAM files.
+template <typename VIEW>
+class pnm_mapped_writer {
+    typedef typename VIEW::x_iterator iterator_t;
+
+    BOOST_STATIC_ASSERT(pnm_mapped_support_private<iterator_t>::writable);
+
+    enum { channels = pnm_mapped_support_private<iterator_t>::channels };
+
+public:
+    pnm_mapped_writer(const char* filename, int width, int height)
+    : _header(pnm_writer::header(channels == 1 ? type_gray_bin : channels == 3 ? type_color_bin : type_pam, width, height, channels, 255))
+    , _map(filename, _header.size() + std::size_t(width) * channels * height)
+    , _view(interleaved_view(width, height, reinterpret_cast<iterator_t>(_map.data() + _header.size()), width * channels)) {
+      memcpy(_map.data(), _header.data(), _header.size());
+    }
+
+    const VIEW& get_view() const { return _view; }
+
+private:
+    std::string _header;
+    mapped_file _map;
+    VIEW        _view;
+};
+
 } // namespace detail
 
 ADOBE_GIL_NAMESPACE_END
@@ -0,0 +1,272 @@
+/*
+  Copyright 2005-2006 Adobe Systems Incorporated
+  Distributed under the MIT License (see accompanying file LICENSE_1_0_0.txt
+  or a copy at http://opensource.adobe.com/licenses.html)
+*/
+
+/*************************************************************************************************/
+
+#ifndef GIL_PNM_PARALLEL_IO_H
+#define GIL_PNM_PARALLEL_IO_H
+
+/// \file
+/// \brief  Multi-threaded parsing of ASCII PNM files
+//
+/// \author Christian Henning
+///
+/// \date   2007 \n Last updated February 12, 2007
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <boost/bind.hpp>
+#include <boost/ref.hpp>
+#include <boost/thread/thread.hpp>
+#include "pnm_io.hpp"
+
+ADOBE_GIL_NAMESPACE_BEGIN
+
+namespace detail {
+
+/// Parses the samples of ASCII PNM files (P1 to P3) on several threads. The raster text is loaded
+/// whole and cut into chunks at white space; one pass counts the samples of every chunk, so that
+/// a second pass can parse every chunk straight into its place in the sample array.
+class pnm_parallel_reader : public pnm_reader {
+public:
+    pnm_parallel_reader(const char* filename)    : pnm_reader(filename) {}
+    pnm_parallel_reader(const wchar_t* filename) : pnm_reader(filename) {}
+
+    /// Decodes into view using the given number of threads, zero for one per core.
+    /// Binary files are read on the calling thread.
+    template <typename VIEW>
+    void apply( const VIEW& view, int threads )
+    {
+      typedef typename VIEW::color_space_t::base color_space_t;
+
+      if( type != type_mono_asc && type != type_gray_asc && type != type_color_asc )
+      {
+         pnm_reader::apply( view );
+         return;
+      }
+
+      io_error_if( view.dimensions() != get_dimensions()
+                 , "pnm_parallel_reader::apply(): input view dimensions do not match the image file");
+
+      if( pnm_read_write_support_private<typename VIEW::channel_t, color_space_t>::channel != 8 &&
+          pnm_read_write_support_private<typename VIEW::channel_t, color_space_t>::channel != 16 )
+      {
+         io_error( "Input view type is incompatible with the image type" );
+      }
+
+      if( threads <= 0 )
+      {
+         threads = boost::thread::hardware_concurrency();
+      }
+      threads = std::max( 1, threads );
+
+      std::vector<byte_t> text;
+      _in.read_rest( text );
+
+      const std::size_t len = text.size();
+
+      if( len == 0 )
+      {
+         return;
+      }
+
+      const byte_t* base = &text.front();
+
+      // cut the text at white space
+      std::vector<chunk> chunks( threads );
+
+      std::size_t at = 0;
+
+      for( int i = 0; i < threads; ++i )
+      {
+         std::size_t end = ( i + 1 == threads ) ? len : std::max( at, len * ( i + 1 ) / threads );
+
+         while( end < len && !pnm_space( text[end] ))
+         {
+            ++end;
+         }
+
+         chunks[i].first  = base + at;
+         chunks[i].last   = base + end;
+         chunks[i].single = ( type == type_mono_asc );
+         chunks[i].wide   = wide();
+         chunks[i].dest   = 0;
+         chunks[i].cnt    = 0;
+
+         at = end;
+      }
+
+      // count the samples of every chunk
+      run( chunks );
+
+      // samples of a chunk go after those of the chunks before it; nothing after a bad character counts
+      const int         pitch = get_pitch();
+      const int         row   = width * channels;
+      const std::size_t total = std::size_t( row ) * height;
+
+      std::vector<byte_t> samples( std::max<std::size_t>( std::size_t( pitch ) * height, 1 ));
+      std::size_t         valid = 0;
+
+      for( int i = 0; i < threads; ++i )
+      {
+         chunks[i].dest = &samples.front() + std::min( valid, total ) * ( wide() ? 2 : 1 );
+         chunks[i].cnt  = total - std::min( valid, total );
+
+         valid += chunks[i].found;
+
+         if( chunks[i].bad )
+         {
+            // later chunks are not parsed
+            for( ++i; i < threads; ++i )
+            {
+               chunks[i].first = chunks[i].last;
+            }
+         }
+      }
+
+      // parse the samples into place
+      run( chunks );
+
+      // only complete rows are converted, as when parsing sequentially
+      pnm_rescale<typename VIEW::channel_t> scale( negative(), maxv, wide() );
+
+      typename transfer_pnm<VIEW, color_space_t>::read_fn convert = transfer_pnm<VIEW, color_space_t>::reader( bpp, channels, scale );
+
+      int rows = int( std::min<std::size_t>( valid, total ) / std::max( row, 1 ));
+
+      for( int y = 0; y < rows; ++y )
+      {
+         convert( &samples[std::size_t( y ) * pitch], view.row_begin( y ), width, scale );
+      }
+    }
+
+    template <typename IMAGE>
+    void read_image( IMAGE& im, int threads )
+    {
+        resize_clobber_image( im, get_dimensions() );
+        apply( view( im ), threads );
+    }
+
+private:
+    /// One stretch of raster text
+    struct chunk {
+      const byte_t* first;
+      const byte_t* last;
+      bool          single;
+      bool          wide;
+      byte_t*       dest;
+      std::size_t   cnt;
+      std::size_t   found;
+      bool          bad;
+    };
+
+    static void parse( chunk& c )
+    {
+      c.found = pnm_parse_ascii( c.first, c.last, c.single, c.wide, c.dest, c.cnt, c.bad );
+    }
+
+    /// Parses every chunk, the first one on the calling thread
+    static void run( std::vector<chunk>& chunks )
+    {
+      boost::thread_group group;
+
+      try
+      {
+         for( std::size_t i = 1; i < chunks.size(); ++i )
+         {
+            group.create_thread( boost::bind( &pnm_parallel_reader::parse, boost::ref( chunks[i] )));
+         }
+      }
+      catch( ... )
+      {
+         group.join_all();
+         throw;
+      }
+
+      parse( chunks[0] );
+      group.join_all();
+    }
+};
+
+} // namespace detail
+
+/// \brief Loads the image specified by the given pnm image file name into the given view, parsing ASCII samples in parallel.
+/// \ingroup PNM_IO
+/// threads is the number of threads to use, zero for one per core. The raster of ASCII files (P1 to P3) is loaded whole;
+/// binary files are read like by pnm_read_view.
+/// Triggers a compile assert if the view color space and channel depth are not supported by the PNM library or by the I/O extension.
+/// Throws std::ios_base::failure if the file is not a valid PNM file, or if its color space or channel depth are not
+/// compatible with the ones specified by VIEW, or if its dimensions don't match the ones of the view.
+template <typename VIEW>
+inline void pnm_read_view_parallel(const wchar_t* filename,const VIEW& view,int threads=0) {
+    BOOST_STATIC_ASSERT(pnm_read_write_support<VIEW>::is_supported);
+
+    detail::pnm_parallel_reader m(filename);
+    m.apply(view,threads);
+}
+
+/// \brief Loads the image specified by the given pnm image file name into the given view, parsing ASCII samples in parallel.
+/// \ingroup PNM_IO
+/// threads is the number of threads to use, zero for one per core. The raster of ASCII files (P1 to P3) is loaded whole;
+/// binary files are read like by pnm_read_view.
+/// Triggers a compile assert if the view color space and channel depth are not supported by the PNM library or by the I/O extension.
+/// Throws std::ios_base::failure if the file is not a valid PNM file, or if its color space or channel depth are not
+/// compatible with the ones specified by VIEW, or if its dimensions don't match the ones of the view.
+template <typename VIEW>
+inline void pnm_read_view_parallel(const char* filename,const VIEW& view,int threads=0) {
+    BOOST_STATIC_ASSERT(pnm_read_write_support<VIEW>::is_supported);
+
+    detail::pnm_parallel_reader m(filename);
+    m.apply(view,threads);
+}
+
+/// \brief Loads the image specified by the given pnm image file name into the given view, parsing ASCII samples in parallel.
+/// \ingroup PNM_IO
+template <typename VIEW>
+inline void pnm_read_view_parallel(const std::string& filename,const VIEW& view,int threads=0) {
+    pnm_read_view_parallel(filename.c_str(),view,threads);
+}
+
+/// \brief Allocates a new image whose dimensions are determined by the given pnm image file, and loads the pixels into it
+/// parsing ASCII samples in parallel.
+/// \ingroup PNM_IO
+/// Triggers a compile assert if the image color space or channel depth are not supported by the PNM library or by the I/O extension.
+/// Throws std::ios_base::failure if the file is not a valid PNM file, or if its color space or channel depth are not
+/// compatible with the ones specified by IMAGE
+template <typename IMAGE>
+inline void pnm_read_image_parallel(const wchar_t* filename,IMAGE& im,int threads=0) {
+    BOOST_STATIC_ASSERT(pnm_read_write_support<typename IMAGE::view_t>::is_supported);
+
+    detail::pnm_parallel_reader m(filename);
+    m.read_image(im,threads);
+}
+
+/// \brief Allocates a new image whose dimensions are determined by the given pnm image file, and loads the pixels into it
+/// parsing ASCII samples in parallel.
+/// \ingroup PNM_IO
+/// Triggers a compile assert if the image color space or channel depth are not supported by the PNM library or by the I/O extension.
+/// Throws std::ios_base::failure if the file is not a valid PNM file, or if its color space or channel depth are not
+/// compatible with the ones specified by IMAGE
+template <typename IMAGE>
+inline void pnm_read_image_parallel(const char* filename,IMAGE& im,int threads=0) {
+    BOOST_STATIC_ASSERT(pnm_read_write_support<typename IMAGE::view_t>::is_supported);
+
+    detail::pnm_parallel_reader m(filename);
+    m.read_image(im,threads);
+}
+
+/// \brief Allocates a new image whose dimensions are determined by the given pnm image file, and loads the pixels into it
+/// parsing ASCII samples in parallel.
+/// \ingroup PNM_IO
+template <typename IMAGE>
+inline void pnm_read_image_parallel(const std::string& filename,IMAGE& im,int threads=0) {
+    pnm_read_image_parallel(filename.c_str(),im,threads);
+}
+
+ADOBE_GIL_NAMESPACE_END
+
+#endif
@@ -0,0 +1,156 @@
+/*
+  Copyright 2005-2006 Adobe Systems Incorporated
+  Distributed under the MIT License (see accompanying file LICENSE_1_0_0.txt
+  or a copy at http://opensource.adobe.com/licenses.html)
+*/
+
+/*************************************************************************************************/
+
+#ifndef GIL_PNM_STREAM_IO_H
+#define GIL_PNM_STREAM_IO_H
+
+/// \file
+/// \brief  Reading streams of concatenated PNM frames
+//
+/// \author Christian Henning
+///
+/// \date   2007 \n Last updated February 12, 2007
+
+#include <stdio.h>
+#include <boost/scoped_ptr.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include "pnm_io.hpp"
+
+ADOBE_GIL_NAMESPACE_BEGIN
+
+namespace detail {
+
+/// Reads one PNM frame after the other from a file descriptor. The image, the row buffer
+/// and the sample table are kept from frame to frame while the frame format doesn't change.
+template <typename IMAGE>
+class pnm_stream_reader : public pnm_reader {
+public:
+    typedef typename IMAGE::view_t               view_t;
+    typedef typename view_t::channel_t           channel_t;
+    typedef typename view_t::color_space_t::base color_space_t;
+
+    pnm_stream_reader(int fd)
+    : pnm_reader(fd), _frames(0), _latency(0), _resized(false), _scale_negative(false), _scale_maxv(0) {}
+
+    /// Reads the next frame, returns false at the end of the stream
+    bool next()
+    {
+      // frames may be separated by white space
+      int ch = _in.peek();
+
+      while( pnm_space( ch ))
+      {
+         _in.next();
+         ch = _in.peek();
+      }
+
+      if( ch == EOF )
+      {
+         return false;
+      }
+
+      ptime start = now();
+
+      init();
+
+      if( pnm_read_write_support_private<channel_t, color_space_t>::channel != 8 &&
+          pnm_read_write_support_private<channel_t, color_space_t>::channel != 16 )
+      {
+         io_error( "Input view type is incompatible with the image type" );
+      }
+
+      _resized = ( view( _image ).dimensions() != get_dimensions() );
+
+      if( _resized )
+      {
+         resize_clobber_image( _image, get_dimensions() );
+      }
+
+      if( !_scale || negative() != _scale_negative || maxv != _scale_maxv )
+      {
+         _scale.reset( new pnm_rescale<channel_t>( negative(), maxv, wide() ));
+         _scale_negative = negative();
+         _scale_maxv     = maxv;
+      }
+
+      io_error_if( !read_raster( view( _image ), *_scale ), "pnm_stream_reader::next(): truncated frame" );
+
+      ++_frames;
+      _latency = ( now() - start ).total_microseconds() / 1e6;
+
+      return true;
+    }
+
+    const IMAGE& image() const { return _image; }
+    view_t       get_view()    { return view( _image ); }
+
+    int    frames() const  { return _frames;  }
+    double latency() const { return _latency; }
+    bool   resized() const { return _resized; }
+
+private:
+    typedef boost::posix_time::ptime ptime;
+
+    static ptime now()
+    {
+      return boost::posix_time::microsec_clock::universal_time();
+    }
+
+    IMAGE                                       _image;
+    int                                         _frames;
+    double                                      _latency;
+    bool                                        _resized;
+    boost::scoped_ptr< pnm_rescale<channel_t> > _scale;
+    bool                                        _scale_negative;
+    int                                         _scale_maxv;
+};
+
+} // namespace detail
+
+/// \brief Reads the frames of a stream of concatenated PNM images, such as a video decoder writes to a pipe.
+/// \ingroup PNM_IO
+/// The stream doesn't need to be seekable. Every call of next() decodes one frame into the same image, which is only
+/// reallocated when the frame dimensions change; frames may differ in type and maximum value. The stream is read
+/// through its file descriptor, so nothing must have been read from a FILE* before it is handed over, and it isn't
+/// closed. latency() tells the time from the arrival of the first byte of the last frame to the end of its conversion.
+/// Triggers a compile assert if the image color space or channel depth are not supported by the PNM library or by the I/O extension.
+/// Throws std::ios_base::failure if a frame is not a valid PNM image or the stream ends within a frame.
+template <typename IMAGE>
+class pnm_frame_reader {
+    BOOST_STATIC_ASSERT(pnm_read_write_support<typename IMAGE::view_t>::is_supported);
+
+public:
+    typedef IMAGE                     image_t;
+    typedef typename IMAGE::view_t    view_t;
+
+    explicit pnm_frame_reader(int fd)     : _reader(fd) {}
+    explicit pnm_frame_reader(FILE* file) : _reader(fileno(file)) {}
+
+    /// Decodes the next frame, returns false at the end of the stream
+    bool next() { return _reader.next(); }
+
+    /// The last frame decoded
+    const image_t& image() const { return _reader.image(); }
+    view_t         view()        { return _reader.get_view(); }
+
+    /// Number of frames decoded so far
+    int frames() const { return _reader.frames(); }
+
+    /// Seconds spent on the last frame
+    double latency() const { return _reader.latency(); }
+
+    /// Tells whether the last frame had other dimensions than the one before, so the image was reallocated
+    bool resized() const { return _reader.resized(); }
+
+private:
+    detail::pnm_stream_reader<IMAGE> _reader;
+};
+
+ADOBE_GIL_NAMESPACE_END
+
+#endif
@@ -0,0 +1,256 @@
+/*
+  Copyright 2005-2006 Adobe Systems Incorporated
+  Distributed under the MIT License (see accompanying file LICENSE_1_0_0.txt
+  or a copy at http://opensource.adobe.com/licenses.html)
+*/
+
+/*************************************************************************************************/
+
+#ifndef GIL_READ_AHEAD_IO_H
+#define GIL_READ_AHEAD_IO_H
+
+/// \file
+/// \brief  Device reading ahead on a background thread, so file I/O overlaps with decoding
+//
+/// \author Christian Henning
+///
+/// \date   2007 \n Last updated February 12, 2007
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <deque>
+#include <string>
+#include <vector>
+#include <boost/bind.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include "io_device.hpp"
+
+ADOBE_GIL_NAMESPACE_BEGIN
+
+namespace detail {
+
+/// Reads the underlying device sequentially in bands on an I/O thread, which keeps up to
+/// depth bands queued while the decoding thread consumes the band before. A forward seek
+/// into what is already queued skips ahead; any other seek restarts the thread at the new
+/// position. Positional reads go straight to the underlying device.
+class read_ahead_device : public io_device {
+public:
+    read_ahead_device(const io_device_ptr& dev, std::size_t band, int depth)
+    : _dev(dev), _band(std::max<std::size_t>(band, 4096)), _depth(std::max(depth, 1))
+    , _used(0), _pos(0), _start(0), _queued(0), _stop(false), _end(false) {
+        start();
+    }
+
+    ~read_ahead_device() {
+        stop();
+    }
+
+    std::size_t read(void* buf, std::size_t cnt) {
+        std::size_t n = 0;
+
+        while (n < cnt) {
+            std::size_t got = read_some(static_cast<byte_t*>(buf) + n, cnt - n);
+
+            if (got == 0) {
+                break;
+            }
+            n += got;
+        }
+        return n;
+    }
+
+    /// Reads from the current band only, waiting for the next one when it is used up
+    std::size_t read_some(void* buf, std::size_t cnt) {
+        if (_used == _current.size() && !next()) {
+            return 0;
+        }
+        std::size_t n = std::min(cnt, _current.size() - _used);
+
+        memcpy(buf, &_current[_used], n);
+        _used += n;
+        return n;
+    }
+
+    std::size_t write(const void* buf, std::size_t cnt) {
+        return 0;
+    }
+
+    std::size_t read_at(void* buf, std::size_t cnt, boost::uint64_t at) {
+        return _dev->read_at(buf, cnt, at);
+    }
+
+    bool seek(boost::uint64_t at) {
+        if (at >= _pos + _used) {
+            boost::uint64_t skip = at - (_pos + _used);
+
+            // headers are usually followed closely by the raster, which is read already
+            if (skip <= (_current.size() - _used) + queued()) {
+                while (skip > 0) {
+                    if (_used == _current.size() && !next()) {
+                        break;
+                    }
+                    std::size_t n = std::size_t(std::min<boost::uint64_t>(skip, _current.size() - _used));
+
+                    _used += n;
+                    skip  -= n;
+                }
+                return skip == 0;
+            }
+        }
+
+        stop();
+
+        bool ok = _dev->seek(at);
+
+        _current.clear();
+        _used  = 0;
+        _start = at;
+
+        start();
+        return ok;
+    }
+
+private:
+    /// Makes the next queued band current, returns false at the end of the device
+    bool next() {
+        boost::mutex::scoped_lock lock(_mutex);
+
+        while (_bands.empty() && !_end) {
+            _ready.wait(lock);
+        }
+        if (_bands.empty()) {
+            return false;
+        }
+
+        // the used band goes back to the I/O thread
+        _current.swap(_bands.front());
+        _free.push_back(std::vector<byte_t>());
+        _free.back().swap(_bands.front());
+        _bands.pop_front();
+
+        _pos    += _used;
+        _used    = 0;
+        _queued -= _current.size();
+
+        _space.notify_one();
+        return !_current.empty();
+    }
+
+    std::size_t queued() {
+        boost::mutex::scoped_lock lock(_mutex);
+        return _queued;
+    }
+
+    /// Reads bands into the queue until the device ends or the reader stops
+    void run() {
+        for (;;) {
+            std::vector<byte_t> buf;
+            {
+                boost::mutex::scoped_lock lock(_mutex);
+
+                while (!_stop && int(_bands.size()) >= _depth) {
+                    _space.wait(lock);
+                }
+                if (_stop) {
+                    return;
+                }
+                if (!_free.empty()) {
+                    buf.swap(_free.back());
+                    _free.pop_back();
+                }
+            }
+
+            buf.resize(_band);
+            buf.resize(_dev->read(&buf.front(), _band));
+
+            boost::mutex::scoped_lock lock(_mutex);
+
+            bool last = (buf.size() < _band);
+
+            if (!buf.empty()) {
+                _queued += buf.size();
+                _bands.push_back(std::vector<byte_t>());
+                _bands.back().swap(buf);
+            }
+            _end = last;
+            _ready.notify_one();
+
+            if (last) {
+                return;
+            }
+        }
+    }
+
+    void start() {
+        _pos  = _start;
+        _stop = false;
+        _end  = false;
+        _thread.reset(new boost::thread(boost::bind(&read_ahead_device::run, this)));
+    }
+
+    void stop() {
+        {
+            boost::mutex::scoped_lock lock(_mutex);
+            _stop = true;
+            _space.notify_one();
+        }
+        _thread->join();
+
+        _bands.clear();
+        _queued = 0;
+    }
+
+    io_device_ptr                    _dev;
+    std::size_t                      _band;
+    int                              _depth;
+
+    std::vector<byte_t>              _current;	///< band being consumed
+    std::size_t                      _used;		///< bytes of _current consumed
+    boost::uint64_t                  _pos;		///< device position of _current
+    boost::uint64_t                  _start;	///< device position the I/O thread started at
+
+    boost::mutex                     _mutex;
+    boost::condition_variable        _ready;	///< a band was queued or the device ended
+    boost::condition_variable        _space;	///< a band was taken or the reader stops
+    std::deque< std::vector<byte_t> > _bands;
+    std::vector< std::vector<byte_t> > _free;	///< used bands kept for reuse
+    std::size_t                      _queued;	///< bytes in _bands
+    bool                             _stop;
+    bool                             _end;
+    boost::scoped_ptr<boost::thread> _thread;
+};
+
+} // namespace detail
+
+/// \brief Device reading the given device ahead on a background thread, so that the decoding of one band overlaps
+/// with the reading of the next ones. Pass it to bmp_read_image, pnm_read_image and the other readers taking a device.
+/// \ingroup IO
+/// band_size is the number of bytes read at once, queue_depth the number of bands read ahead. Nothing must have been
+/// read from the given device before.
+inline io_device_ptr make_read_ahead_device(const io_device_ptr& dev, std::size_t band_size = 1 << 20, int queue_depth = 2) {
+    return io_device_ptr(new detail::read_ahead_device(dev, band_size, queue_depth));
+}
+
+/// \brief Device reading the given file ahead on a background thread.
+/// \ingroup IO
+/// Throws std::ios_base::failure if the file can't be opened.
+inline io_device_ptr make_read_ahead_device(const char* filename, std::size_t band_size = 1 << 20, int queue_depth = 2) {
+    FILE* fp;
+    io_error_if((fp=fopen(filename,"rb"))==NULL, "make_read_ahead_device: failed to open file");
+
+    return make_read_ahead_device(io_device_ptr(new detail::stdio_device(fp, true)), band_size, queue_depth);
+}
+
+/// \brief Device reading the given file ahead on a background thread.
+/// \ingroup IO
+inline io_device_ptr make_read_ahead_device(const std::string& filename, std::size_t band_size = 1 << 20, int queue_depth = 2) {
+    return make_read_ahead_device(filename.c_str(), band_size, queue_depth);
+}
+
+ADOBE_GIL_NAMESPACE_END
+
+#endif
@@ -0,0 +1,627 @@
+/*
+  Copyright 2005-2006 Adobe Systems Incorporated
+  Distributed under the MIT License (see accompanying file LICENSE_1_0_0.txt
+  or a copy at http://opensource.adobe.com/licenses.html)
+*/
+
+/*************************************************************************************************/
+
+#ifndef GIL_ROW_CONVERT_H
+#define GIL_ROW_CONVERT_H
+
+/// \file
+/// \brief  Vectorized row kernels for the BMP and PNM transfer functions
+//
+/// \author Christian Henning
+///
+/// \date   2007 \n Last updated February 19, 2007
+///
+/// The kernels work on raw interleaved 8 bit rows and on 16 bit samples. The best implementation for
+/// the running CPU (SSE2, SSSE3, AVX2 or plain C++) is picked once, on first use.
+/// Define GIL_IO_NO_SIMD to always use the plain C++ versions.
+
+#include <string.h>
+#include <algorithm>
+#include <boost/cstdint.hpp>
+#include "../../core/gil_all.hpp"
+#include "io_error.hpp"
+
+#if !defined GIL_IO_NO_SIMD && (defined __x86_64__ || defined __i386__ || defined _M_X64 || defined _M_IX86)
+	#define GIL_IO_SIMD
+
+	#include <emmintrin.h>
+	#include <tmmintrin.h>
+	#include <immintrin.h>
+
+	#if defined _MSC_VER
+		#include <intrin.h>
+		#define GIL_IO_TARGET(isa)
+	#else
+		#define GIL_IO_TARGET(isa) __attribute__((target(isa)))
+	#endif
+#endif
+
+ADOBE_GIL_NAMESPACE_BEGIN
+
+namespace detail {
+
+/// Converts a row of cnt pixels
+typedef void (*row_kernel)(const byte_t *src, byte_t *dest, int cnt);
+
+/// Rescales cnt samples of range 0-maxv
+typedef void (*scale_kernel)(const byte_t *src, byte_t *dest, int cnt, int maxv);
+
+/// Row kernels for one instruction set
+struct row_kernels {
+	row_kernel swap_rb_24;		///< 8-8-8 BGR to RGB and back
+	row_kernel bgrx_to_rgba;	///< 8-8-8-8 BGR* to RGBA, alpha is set to 255
+	row_kernel rgba_to_bgrx;	///< 8-8-8-8 RGBA to BGR*, the unused byte is set to 0
+	row_kernel rgba_to_rgb;		///< 8-8-8-8 RGBA to 8-8-8 RGB
+	row_kernel gray_to_rgb;		///< 8 gray to 8-8-8 RGB
+	row_kernel gray_to_rgba;	///< 8 gray to 8-8-8-8 RGBA, alpha is set to 255
+	row_kernel unpack_555;		///< 5-5-5 BGR little endian words to 8-8-8 RGB
+	row_kernel unpack_565;		///< 5-6-5 BGR little endian words to 8-8-8 RGB
+	row_kernel be16_to_native;	///< 16 bit big endian samples to native words
+	row_kernel native_to_be16;	///< native words to 16 bit big endian samples
+	scale_kernel scale_be16;	///< 16 bit big endian samples of range 0-maxv to native words of range 0-65535
+};
+
+/// Plain C++ kernels
+struct row_kernels_c {
+	static void swap_rb_24(const byte_t *src, byte_t *dest, int cnt) throw() {
+		for (; cnt > 0; --cnt, src += 3, dest += 3) {
+			byte_t c = src[0];
+
+			dest[1] = src[1];
+			dest[0] = src[2];
+			dest[2] = c;
+		}
+	}
+
+	static void bgrx_to_rgba(const byte_t *src, byte_t *dest, int cnt) throw() {
+		for (; cnt > 0; --cnt, src += 4, dest += 4) {
+			byte_t c = src[0];
+
+			dest[1] = src[1];
+			dest[0] = src[2];
+			dest[2] = c;
+			dest[3] = 0xFF;
+		}
+	}
+
+	static void rgba_to_bgrx(const byte_t *src, byte_t *dest, int cnt) throw() {
+		for (; cnt > 0; --cnt, src += 4, dest += 4) {
+			byte_t c = src[0];
+
+			dest[1] = src[1];
+			dest[0] = src[2];
+			dest[2] = c;
+			dest[3] = 0;
+		}
+	}
+
+	static void rgba_to_rgb(const byte_t *src, byte_t *dest, int cnt) throw() {
+		for (; cnt > 0; --cnt, src += 4, dest += 3) {
+			dest[0] = src[0];
+			dest[1] = src[1];
+			dest[2] = src[2];
+		}
+	}
+
+	static void gray_to_rgb(const byte_t *src, byte_t *dest, int cnt) throw() {
+		for (; cnt > 0; --cnt, ++src, dest += 3) {
+			dest[0] = dest[1] = dest[2] = *src;
+		}
+	}
+
+	static void gray_to_rgba(const byte_t *src, byte_t *dest, int cnt) throw() {
+		for (; cnt > 0; --cnt, ++src, dest += 4) {
+			dest[0] = dest[1] = dest[2] = *src;
+			dest[3] = 0xFF;
+		}
+	}
+
+	static void unpack_555(const byte_t *src, byte_t *dest, int cnt) throw() {
+		for (; cnt > 0; --cnt, src += 2, dest += 3) {
+			int p = (src[1] << 8) | src[0];
+
+			dest[0] = byte_t((p >> 7) & 0xF8);
+			dest[1] = byte_t((p >> 2) & 0xF8);
+			dest[2] = byte_t((p << 3) & 0xF8);
+		}
+	}
+
+	static void unpack_565(const byte_t *src, byte_t *dest, int cnt) throw() {
+		for (; cnt > 0; --cnt, src += 2, dest += 3) {
+			int p = (src[1] << 8) | src[0];
+
+			dest[0] = byte_t((p >> 8) & 0xF8);
+			dest[1] = byte_t((p >> 3) & 0xFC);
+			dest[2] = byte_t((p << 3) & 0xF8);
+		}
+	}
+
+	static void be16_to_native(const byte_t *src, byte_t *dest, int cnt) throw() {
+		boost::uint16_t *d = reinterpret_cast<boost::uint16_t*>(dest);
+
+		for (; cnt > 0; --cnt, src += 2) {
+			*d++ = boost::uint16_t((src[0] << 8) | src[1]);
+		}
+	}
+
+	static void native_to_be16(const byte_t *src, byte_t *dest, int cnt) throw() {
+		const boost::uint16_t *s = reinterpret_cast<const boost::uint16_t*>(src);
+
+		for (; cnt > 0; --cnt, dest += 2) {
+			dest[0] = byte_t(*s >> 8);
+			dest[1] = byte_t(*s++);
+		}
+	}
+
+	/// Samples above maxv are clamped to it
+	static void scale_be16(const byte_t *src, byte_t *dest, int cnt, int maxv) throw() {
+		boost::uint16_t *d = reinterpret_cast<boost::uint16_t*>(dest);
+
+		for (; cnt > 0; --cnt, src += 2) {
+			boost::uint32_t v = std::min<boost::uint32_t>((src[0] << 8) | src[1], maxv);
+
+			*d++ = boost::uint16_t(v * 65535 / maxv);
+		}
+	}
+};
+
+#if defined GIL_IO_SIMD
+
+/// SSE2 kernels, only the 32 bit swizzles and the gray expansion don't need byte shuffles
+struct row_kernels_sse2 {
+	GIL_IO_TARGET("sse2")
+	static __m128i swap_rb_32(__m128i p) {
+		const __m128i g = _mm_set1_epi32(0x0000FF00);
+		const __m128i b = _mm_set1_epi32(0x000000FF);
+
+		return _mm_or_si128(_mm_or_si128(_mm_and_si128(p, g), _mm_and_si128(_mm_srli_epi32(p, 16), b)),
+		                    _mm_slli_epi32(_mm_and_si128(p, b), 16));
+	}
+
+	GIL_IO_TARGET("sse2")
+	static void bgrx_to_rgba(const byte_t *src, byte_t *dest, int cnt) {
+		const __m128i a = _mm_set1_epi32(int(0xFF000000));
+
+		for (; cnt >= 4; cnt -= 4, src += 16, dest += 16) {
+			__m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dest), _mm_or_si128(swap_rb_32(p), a));
+		}
+		row_kernels_c::bgrx_to_rgba(src, dest, cnt);
+	}
+
+	GIL_IO_TARGET("sse2")
+	static void rgba_to_bgrx(const byte_t *src, byte_t *dest, int cnt) {
+		for (; cnt >= 4; cnt -= 4, src += 16, dest += 16) {
+			__m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dest), swap_rb_32(p));
+		}
+		row_kernels_c::rgba_to_bgrx(src, dest, cnt);
+	}
+
+	GIL_IO_TARGET("sse2")
+	static void gray_to_rgba(const byte_t *src, byte_t *dest, int cnt) {
+		const __m128i a = _mm_set1_epi8(char(0xFF));
+
+		for (; cnt >= 16; cnt -= 16, src += 16, dest += 64) {
+			__m128i y  = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+			__m128i lo = _mm_unpacklo_epi8(y, y);
+			__m128i hi = _mm_unpackhi_epi8(y, y);
+			__m128i la = _mm_unpacklo_epi8(y, a);
+			__m128i ha = _mm_unpackhi_epi8(y, a);
+
+			__m128i *d = reinterpret_cast<__m128i*>(dest);
+			_mm_storeu_si128(d + 0, _mm_unpacklo_epi16(lo, la));
+			_mm_storeu_si128(d + 1, _mm_unpackhi_epi16(lo, la));
+			_mm_storeu_si128(d + 2, _mm_unpacklo_epi16(hi, ha));
+			_mm_storeu_si128(d + 3, _mm_unpackhi_epi16(hi, ha));
+		}
+		row_kernels_c::gray_to_rgba(src, dest, cnt);
+	}
+
+	GIL_IO_TARGET("sse2")
+	static __m128i swap_16(__m128i p) {
+		return _mm_or_si128(_mm_slli_epi16(p, 8), _mm_srli_epi16(p, 8));
+	}
+
+	/// Both directions between big endian samples and native words are a byte swap on x86
+	GIL_IO_TARGET("sse2")
+	static void swap_16(const byte_t *src, byte_t *dest, int cnt) {
+		for (; cnt >= 8; cnt -= 8, src += 16, dest += 16) {
+			__m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dest), swap_16(p));
+		}
+		row_kernels_c::be16_to_native(src, dest, cnt);
+	}
+
+	/// floor(v * 65535 / maxv) for four 32 bit lanes, in double precision. The products need far fewer
+	/// bits than the mantissa has and a quotient that isn't whole is at least 1 / maxv away from the
+	/// next integer, so the bias only lifts whole quotients that came out a hair too small.
+	GIL_IO_TARGET("sse2")
+	static __m128i scale_4(__m128i v, __m128d f, __m128d bias) {
+		__m128d lo = _mm_add_pd(_mm_mul_pd(_mm_cvtepi32_pd(v), f), bias);
+		__m128d hi = _mm_add_pd(_mm_mul_pd(_mm_cvtepi32_pd(_mm_srli_si128(v, 8)), f), bias);
+
+		return _mm_unpacklo_epi64(_mm_cvttpd_epi32(lo), _mm_cvttpd_epi32(hi));
+	}
+
+	GIL_IO_TARGET("sse2")
+	static void scale_be16(const byte_t *src, byte_t *dest, int cnt, int maxv) {
+		const __m128d f    = _mm_set1_pd(65535.0 / maxv);
+		const __m128d bias = _mm_set1_pd(1.0 / (1 << 20));
+		const __m128i top  = _mm_set1_epi16(short(maxv));
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i half = _mm_set1_epi32(0x8000);
+		const __m128i flip = _mm_set1_epi16(short(0x8000));
+
+		for (; cnt >= 8; cnt -= 8, src += 16, dest += 16) {
+			__m128i v = swap_16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src)));
+
+			// unsigned min(v, maxv)
+			v = _mm_sub_epi16(v, _mm_subs_epu16(v, top));
+
+			__m128i lo = scale_4(_mm_unpacklo_epi16(v, zero), f, bias);
+			__m128i hi = scale_4(_mm_unpackhi_epi16(v, zero), f, bias);
+
+			// there is no unsigned 32 to 16 bit pack before SSE4.1, move the range to signed and back
+			__m128i p = _mm_packs_epi32(_mm_sub_epi32(lo, half), _mm_sub_epi32(hi, half));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dest), _mm_xor_si128(p, flip));
+		}
+		row_kernels_c::scale_be16(src, dest, cnt, maxv);
+	}
+};
+
+/// SSSE3 kernels, built on byte shuffles. Shuffle indices of -128 produce zero bytes.
+struct row_kernels_ssse3 {
+	GIL_IO_TARGET("ssse3")
+	static __m128i shuffle(__m128i p, __m128i m) {
+		return _mm_shuffle_epi8(p, m);
+	}
+
+	GIL_IO_TARGET("ssse3")
+	static void swap_rb_24(const byte_t *src, byte_t *dest, int cnt) {
+		// 16 pixels in three registers per step
+		const __m128i m00 = _mm_setr_epi8(2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, 14, 13, 12, -128);
+		const __m128i m01 = _mm_setr_epi8(-128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, 1);
+		const __m128i m10 = _mm_setr_epi8(-128, 15, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128);
+		const __m128i m11 = _mm_setr_epi8(0, -128, 4, 3, 2, 7, 6, 5, 10, 9, 8, 13, 12, 11, -128, 15);
+		const __m128i m12 = _mm_setr_epi8(-128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, 0, -128);
+		const __m128i m21 = _mm_setr_epi8(14, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128);
+		const __m128i m22 = _mm_setr_epi8(-128, 3, 2, 1, 6, 5, 4, 9, 8, 7, 12, 11, 10, 15, 14, 13);
+
+		for (; cnt >= 16; cnt -= 16, src += 48, dest += 48) {
+			const __m128i *s = reinterpret_cast<const __m128i*>(src);
+			__m128i       *d = reinterpret_cast<__m128i*>(dest);
+
+			__m128i a = _mm_loadu_si128(s + 0);
+			__m128i b = _mm_loadu_si128(s + 1);
+			__m128i c = _mm_loadu_si128(s + 2);
+
+			_mm_storeu_si128(d + 0, _mm_or_si128(shuffle(a, m00), shuffle(b, m01)));
+			_mm_storeu_si128(d + 1, _mm_or_si128(_mm_or_si128(shuffle(a, m10), shuffle(b, m11)), shuffle(c, m12)));
+			_mm_storeu_si128(d + 2, _mm_or_si128(shuffle(b, m21), shuffle(c, m22)));
+		}
+		row_kernels_c::swap_rb_24(src, dest, cnt);
+	}
+
+	GIL_IO_TARGET("ssse3")
+	static void bgrx_to_rgba(const byte_t *src, byte_t *dest, int cnt) {
+		const __m128i m = _mm_setr_epi8(2, 1, 0, -128, 6, 5, 4, -128, 10, 9, 8, -128, 14, 13, 12, -128);
+		const __m128i a = _mm_set1_epi32(int(0xFF000000));
+
+		for (; cnt >= 4; cnt -= 4, src += 16, dest += 16) {
+			__m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dest), _mm_or_si128(shuffle(p, m), a));
+		}
+		row_kernels_c::bgrx_to_rgba(src, dest, cnt);
+	}
+
+	GIL_IO_TARGET("ssse3")
+	static void rgba_to_bgrx(const byte_t *src, byte_t *dest, int cnt) {
+		const __m128i m = _mm_setr_epi8(2, 1, 0, -128, 6, 5, 4, -128, 10, 9, 8, -128, 14, 13, 12, -128);
+
+		for (; cnt >= 4; cnt -= 4, src += 16, dest += 16) {
+			__m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dest), shuffle(p, m));
+		}
+		row_kernels_c::rgba_to_bgrx(src, dest, cnt);
+	}
+
+	GIL_IO_TARGET("ssse3")
+	static void rgba_to_rgb(const byte_t *src, byte_t *dest, int cnt) {
+		// 16 pixels from four registers into three per step
+		const __m128i m00 = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -128, -128, -128, -128);
+		const __m128i m01 = _mm_setr_epi8(-128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, 0, 1, 2, 4);
+		const __m128i m11 = _mm_setr_epi8(5, 6, 8, 9, 10, 12, 13, 14, -128, -128, -128, -128, -128, -128, -128, -128);
+		const __m128i m12 = _mm_setr_epi8(-128, -128, -128, -128, -128, -128, -128, -128, 0, 1, 2, 4, 5, 6, 8, 9);
+		const __m128i m22 = _mm_setr_epi8(10, 12, 13, 14, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128);
+		const __m128i m23 = _mm_setr_epi8(-128, -128, -128, -128, 0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14);
+
+		for (; cnt >= 16; cnt -= 16, src += 64, dest += 48) {
+			const __m128i *s = reinterpret_cast<const __m128i*>(src);
+			__m128i       *d = reinterpret_cast<__m128i*>(dest);
+
+			__m128i a = _mm_loadu_si128(s + 0);
+			__m128i b = _mm_loadu_si128(s + 1);
+			__m128i c = _mm_loadu_si128(s + 2);
+			__m128i e = _mm_loadu_si128(s + 3);
+
+			_mm_storeu_si128(d + 0, _mm_or_si128(shuffle(a, m00), shuffle(b, m01)));
+			_mm_storeu_si128(d + 1, _mm_or_si128(shuffle(b, m11), shuffle(c, m12)));
+			_mm_storeu_si128(d + 2, _mm_or_si128(shuffle(c, m22), shuffle(e, m23)));
+		}
+		row_kernels_c::rgba_to_rgb(src, dest, cnt);
+	}
+
+	GIL_IO_TARGET("ssse3")
+	static void gray_to_rgb(const byte_t *src, byte_t *dest, int cnt) {
+		const __m128i m0 = _mm_setr_epi8(0, 0, 0, 1, 1, 1, 2, 2, 2, 3, 3, 3, 4, 4, 4, 5);
+		const __m128i m1 = _mm_setr_epi8(5, 5, 6, 6, 6, 7, 7, 7, 8, 8, 8, 9, 9, 9, 10, 10);
+		const __m128i m2 = _mm_setr_epi8(10, 11, 11, 11, 12, 12, 12, 13, 13, 13, 14, 14, 14, 15, 15, 15);
+
+		for (; cnt >= 16; cnt -= 16, src += 16, dest += 48) {
+			__m128i  y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+			__m128i *d = reinterpret_cast<__m128i*>(dest);
+
+			_mm_storeu_si128(d + 0, shuffle(y, m0));
+			_mm_storeu_si128(d + 1, shuffle(y, m1));
+			_mm_storeu_si128(d + 2, shuffle(y, m2));
+		}
+		row_kernels_c::gray_to_rgb(src, dest, cnt);
+	}
+
+	GIL_IO_TARGET("ssse3")
+	static void gray_to_rgba(const byte_t *src, byte_t *dest, int cnt) {
+		const __m128i m0 = _mm_setr_epi8(0, 0, 0, -128, 1, 1, 1, -128, 2, 2, 2, -128, 3, 3, 3, -128);
+		const __m128i m1 = _mm_setr_epi8(4, 4, 4, -128, 5, 5, 5, -128, 6, 6, 6, -128, 7, 7, 7, -128);
+		const __m128i m2 = _mm_setr_epi8(8, 8, 8, -128, 9, 9, 9, -128, 10, 10, 10, -128, 11, 11, 11, -128);
+		const __m128i m3 = _mm_setr_epi8(12, 12, 12, -128, 13, 13, 13, -128, 14, 14, 14, -128, 15, 15, 15, -128);
+		const __m128i a  = _mm_set1_epi32(int(0xFF000000));
+
+		for (; cnt >= 16; cnt -= 16, src += 16, dest += 64) {
+			__m128i  y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+			__m128i *d = reinterpret_cast<__m128i*>(dest);
+
+			_mm_storeu_si128(d + 0, _mm_or_si128(shuffle(y, m0), a));
+			_mm_storeu_si128(d + 1, _mm_or_si128(shuffle(y, m1), a));
+			_mm_storeu_si128(d + 2, _mm_or_si128(shuffle(y, m2), a));
+			_mm_storeu_si128(d + 3, _mm_or_si128(shuffle(y, m3), a));
+		}
+		row_kernels_c::gray_to_rgba(src, dest, cnt);
+	}
+
+	/// Interleaves 16 red, green and blue bytes into 48 bytes of 8-8-8 RGB
+	GIL_IO_TARGET("ssse3")
+	static void interleave_rgb(__m128i r, __m128i g, __m128i b, byte_t *dest) {
+		const __m128i r0 = _mm_setr_epi8(0, -128, -128, 1, -128, -128, 2, -128, -128, 3, -128, -128, 4, -128, -128, 5);
+		const __m128i g0 = _mm_setr_epi8(-128, 0, -128, -128, 1, -128, -128, 2, -128, -128, 3, -128, -128, 4, -128, -128);
+		const __m128i b0 = _mm_setr_epi8(-128, -128, 0, -128, -128, 1, -128, -128, 2, -128, -128, 3, -128, -128, 4, -128);
+		const __m128i r1 = _mm_setr_epi8(-128, -128, 6, -128, -128, 7, -128, -128, 8, -128, -128, 9, -128, -128, 10, -128);
+		const __m128i g1 = _mm_setr_epi8(5, -128, -128, 6, -128, -128, 7, -128, -128, 8, -128, -128, 9, -128, -128, 10);
+		const __m128i b1 = _mm_setr_epi8(-128, 5, -128, -128, 6, -128, -128, 7, -128, -128, 8, -128, -128, 9, -128, -128);
+		const __m128i r2 = _mm_setr_epi8(-128, 11, -128, -128, 12, -128, -128, 13, -128, -128, 14, -128, -128, 15, -128, -128);
+		const __m128i g2 = _mm_setr_epi8(-128, -128, 11, -128, -128, 12, -128, -128, 13, -128, -128, 14, -128, -128, 15, -128);
+		const __m128i b2 = _mm_setr_epi8(10, -128, -128, 11, -128, -128, 12, -128, -128, 13, -128, -128, 14, -128, -128, 15);
+
+		__m128i *d = reinterpret_cast<__m128i*>(dest);
+
+		_mm_storeu_si128(d + 0, _mm_or_si128(_mm_or_si128(shuffle(r, r0), shuffle(g, g0)), shuffle(b, b0)));
+		_mm_storeu_si128(d + 1, _mm_or_si128(_mm_or_si128(shuffle(r, r1), shuffle(g, g1)), shuffle(b, b1)));
+		_mm_storeu_si128(d + 2, _mm_or_si128(_mm_or_si128(shuffle(r, r2), shuffle(g, g2)), shuffle(b, b2)));
+	}
+
+	GIL_IO_TARGET("ssse3")
+	static void unpack_555(const byte_t *src, byte_t *dest, int cnt) {
+		const __m128i m = _mm_set1_epi16(0xF8);
+
+		for (; cnt >= 16; cnt -= 16, src += 32, dest += 48) {
+			__m128i p0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+			__m128i p1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src) + 1);
+
+			__m128i r = _mm_packus_epi16(_mm_and_si128(_mm_srli_epi16(p0, 7), m), _mm_and_si128(_mm_srli_epi16(p1, 7), m));
+			__m128i g = _mm_packus_epi16(_mm_and_si128(_mm_srli_epi16(p0, 2), m), _mm_and_si128(_mm_srli_epi16(p1, 2), m));
+			__m128i b = _mm_packus_epi16(_mm_and_si128(_mm_slli_epi16(p0, 3), m), _mm_and_si128(_mm_slli_epi16(p1, 3), m));
+
+			interleave_rgb(r, g, b, dest);
+		}
+		row_kernels_c::unpack_555(src, dest, cnt);
+	}
+
+	GIL_IO_TARGET("ssse3")
+	static void unpack_565(const byte_t *src, byte_t *dest, int cnt) {
+		const __m128i m  = _mm_set1_epi16(0xF8);
+		const __m128i mg = _mm_set1_epi16(0xFC);
+
+		for (; cnt >= 16; cnt -= 16, src += 32, dest += 48) {
+			__m128i p0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+			__m128i p1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src) + 1);
+
+			__m128i r = _mm_packus_epi16(_mm_and_si128(_mm_srli_epi16(p0, 8), m),  _mm_and_si128(_mm_srli_epi16(p1, 8), m));
+			__m128i g = _mm_packus_epi16(_mm_and_si128(_mm_srli_epi16(p0, 3), mg), _mm_and_si128(_mm_srli_epi16(p1, 3), mg));
+			__m128i b = _mm_packus_epi16(_mm_and_si128(_mm_slli_epi16(p0, 3), m),  _mm_and_si128(_mm_slli_epi16(p1, 3), m));
+
+			interleave_rgb(r, g, b, dest);
+		}
+		row_kernels_c::unpack_565(src, dest, cnt);
+	}
+};
+
+/// AVX2 kernels for the 32 bit swizzles, where the shuffles stay within 128 bit lanes
+struct row_kernels_avx2 {
+	GIL_IO_TARGET("avx2")
+	static void bgrx_to_rgba(const byte_t *src, byte_t *dest, int cnt) {
+		const __m256i m = _mm256_setr_epi8(2, 1, 0, -128, 6, 5, 4, -128, 10, 9, 8, -128, 14, 13, 12, -128,
+		                                   2, 1, 0, -128, 6, 5, 4, -128, 10, 9, 8, -128, 14, 13, 12, -128);
+		const __m256i a = _mm256_set1_epi32(int(0xFF000000));
+
+		for (; cnt >= 8; cnt -= 8, src += 32, dest += 32) {
+			__m256i p = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dest), _mm256_or_si256(_mm256_shuffle_epi8(p, m), a));
+		}
+		row_kernels_ssse3::bgrx_to_rgba(src, dest, cnt);
+	}
+
+	GIL_IO_TARGET("avx2")
+	static void rgba_to_bgrx(const byte_t *src, byte_t *dest, int cnt) {
+		const __m256i m = _mm256_setr_epi8(2, 1, 0, -128, 6, 5, 4, -128, 10, 9, 8, -128, 14, 13, 12, -128,
+		                                   2, 1, 0, -128, 6, 5, 4, -128, 10, 9, 8, -128, 14, 13, 12, -128);
+
+		for (; cnt >= 8; cnt -= 8, src += 32, dest += 32) {
+			__m256i p = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dest), _mm256_shuffle_epi8(p, m));
+		}
+		row_kernels_ssse3::rgba_to_bgrx(src, dest, cnt);
+	}
+
+	GIL_IO_TARGET("avx2")
+	static void swap_16(const byte_t *src, byte_t *dest, int cnt) {
+		for (; cnt >= 16; cnt -= 16, src += 32, dest += 32) {
+			__m256i p = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dest), _mm256_or_si256(_mm256_slli_epi16(p, 8), _mm256_srli_epi16(p, 8)));
+		}
+		row_kernels_sse2::swap_16(src, dest, cnt);
+	}
+};
+
+#endif // GIL_IO_SIMD
+
+/// CPU feature bits
+enum {
+	cpu_sse2	= 1,
+	cpu_ssse3	= 2,
+	cpu_avx2	= 4
+};
+
+/// Detects the instruction sets usable on the running CPU
+inline int cpu_features() {
+#if defined GIL_IO_SIMD && defined _MSC_VER
+	int info[4];
+	int features = 0;
+
+	__cpuid(info, 0);
+	int max_leaf = info[0];
+
+	__cpuid(info, 1);
+	if (info[3] & (1 << 26)) features |= cpu_sse2;
+	if (info[2] & (1 <<  9)) features |= cpu_ssse3;
+
+	// AVX2 also needs the OS to save the YMM registers
+	if (max_leaf >= 7 && (info[2] & (1 << 27)) && (_xgetbv(0) & 6) == 6) {
+		__cpuidex(info, 7, 0);
+		if (info[1] & (1 << 5)) features |= cpu_avx2;
+	}
+	return features;
+#elif defined GIL_IO_SIMD
+	__builtin_cpu_init();
+
+	return (__builtin_cpu_supports("sse2")  ? cpu_sse2  : 0)
+	     | (__builtin_cpu_supports("ssse3") ? cpu_ssse3 : 0)
+	     | (__builtin_cpu_supports("avx2")  ? cpu_avx2  : 0);
+#else
+	return 0;
+#endif
+}
+
+/// Returns the plain C++ kernels
+inline row_kernels scalar_row_kernels() {
+	row_kernels k;
+
+	k.swap_rb_24   = &row_kernels_c::swap_rb_24;
+	k.bgrx_to_rgba = &row_kernels_c::bgrx_to_rgba;
+	k.rgba_to_bgrx = &row_kernels_c::rgba_to_bgrx;
+	k.rgba_to_rgb  = &row_kernels_c::rgba_to_rgb;
+	k.gray_to_rgb  = &row_kernels_c::gray_to_rgb;
+	k.gray_to_rgba = &row_kernels_c::gray_to_rgba;
+	k.unpack_555   = &row_kernels_c::unpack_555;
+	k.unpack_565   = &row_kernels_c::unpack_565;
+
+	k.be16_to_native = &row_kernels_c::be16_to_native;
+	k.native_to_be16 = &row_kernels_c::native_to_be16;
+	k.scale_be16     = &row_kernels_c::scale_be16;
+
+	return k;
+}
+
+/// Returns the fastest kernels for the given CPU features
+inline row_kernels select_row_kernels(int features) {
+	row_kernels k = scalar_row_kernels();
+
+#if defined GIL_IO_SIMD
+	if (features & cpu_sse2) {
+		k.bgrx_to_rgba = &row_kernels_sse2::bgrx_to_rgba;
+		k.rgba_to_bgrx = &row_kernels_sse2::rgba_to_bgrx;
+		k.gray_to_rgba = &row_kernels_sse2::gray_to_rgba;
+
+		k.be16_to_native = &row_kernels_sse2::swap_16;
+		k.native_to_be16 = &row_kernels_sse2::swap_16;
+		k.scale_be16     = &row_kernels_sse2::scale_be16;
+	}
+	if (features & cpu_ssse3) {
+		k.swap_rb_24   = &row_kernels_ssse3::swap_rb_24;
+		k.bgrx_to_rgba = &row_kernels_ssse3::bgrx_to_rgba;
+		k.rgba_to_bgrx = &row_kernels_ssse3::rgba_to_bgrx;
+		k.rgba_to_rgb  = &row_kernels_ssse3::rgba_to_rgb;
+		k.gray_to_rgb  = &row_kernels_ssse3::gray_to_rgb;
+		k.gray_to_rgba = &row_kernels_ssse3::gray_to_rgba;
+		k.unpack_555   = &row_kernels_ssse3::unpack_555;
+		k.unpack_565   = &row_kernels_ssse3::unpack_565;
+	}
+	if ((features & cpu_avx2) && (features & cpu_ssse3)) {
+		k.bgrx_to_rgba = &row_kernels_avx2::bgrx_to_rgba;
+		k.rgba_to_bgrx = &row_kernels_avx2::rgba_to_bgrx;
+
+		k.be16_to_native = &row_kernels_avx2::swap_16;
+		k.native_to_be16 = &row_kernels_avx2::swap_16;
+	}
+#endif
+	return k;
+}
+
+/// Returns the fastest kernels for the running CPU, detected once
+inline const row_kernels& get_row_kernels() {
+	static const row_kernels k = select_row_kernels(cpu_features());
+	return k;
+}
+
+/// Byte layout of interleaved pixel iterators that the row kernels can work on directly
+enum {
+	layout_other	= 0,
+	layout_gray		= 1,
+	layout_rgb		= 2,
+	layout_bgr		= 3,
+	layout_rgba		= 4,
+	layout_bgra		= 5,
+	layout_gray16	= 6,
+	layout_rgb16	= 7,
+	layout_rgba16	= 8
+};
+
+template <typename It> struct byte_layout { enum { value = layout_other }; };
+
+template <> struct byte_layout<gray8_ptr_t>  { enum { value = layout_gray }; };
+template <> struct byte_layout<gray8c_ptr_t> { enum { value = layout_gray }; };
+template <> struct byte_layout<rgb8_ptr_t>   { enum { value = layout_rgb  }; };
+template <> struct byte_layout<rgb8c_ptr_t>  { enum { value = layout_rgb  }; };
+template <> struct byte_layout<bgr8_ptr_t>   { enum { value = layout_bgr  }; };
+template <> struct byte_layout<bgr8c_ptr_t>  { enum { value = layout_bgr  }; };
+template <> struct byte_layout<rgba8_ptr_t>  { enum { value = layout_rgba }; };
+template <> struct byte_layout<rgba8c_ptr_t> { enum { value = layout_rgba }; };
+template <> struct byte_layout<bgra8_ptr_t>  { enum { value = layout_bgra }; };
+template <> struct byte_layout<bgra8c_ptr_t> { enum { value = layout_bgra }; };
+
+template <> struct byte_layout<gray16_ptr_t>  { enum { value = layout_gray16 }; };
+template <> struct byte_layout<gray16c_ptr_t> { enum { value = layout_gray16 }; };
+template <> struct byte_layout<rgb16_ptr_t>   { enum { value = layout_rgb16  }; };
+template <> struct byte_layout<rgb16c_ptr_t>  { enum { value = layout_rgb16  }; };
+template <> struct byte_layout<rgba16_ptr_t>  { enum { value = layout_rgba16 }; };
+template <> struct byte_layout<rgba16c_ptr_t> { enum { value = layout_rgba16 }; };
+
+} // namespace detail
+
+ADOBE_GIL_NAMESPACE_END
+
+#endif
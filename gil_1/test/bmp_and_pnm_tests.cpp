@@ -10,11 +10,44 @@
 #include <gil/core/image_view_factory.hpp>
 
 #include <gil/extension/io/bmp_dynamic_io.hpp>
+#include <gil/extension/io/bit_packed_io.hpp>
+#include <gil/extension/io/bmp_parallel_io.hpp>
+#include <gil/extension/io/format_registry.hpp>
+#include <gil/extension/io/header_index.hpp>
 #include <gil/extension/io/pnm_dynamic_io.hpp>
+#include <gil/extension/io/pnm_parallel_io.hpp>
+#include <gil/extension/io/pnm_stream_io.hpp>
+#include <gil/extension/io/read_ahead_io.hpp>
 
 using namespace GIL;
 using namespace std;
 
+// Passes reads through to another device and counts the seeks; a device that can't seek
+// stands for a pipe or a socket.
+class counting_device : public detail::io_device {
+public:
+    counting_device(const io_device_ptr& dev, bool seekable) : _dev(dev), _seekable(seekable), seeks(0) {}
+
+    std::size_t read(void* buf, std::size_t cnt)        { return _dev->read(buf, cnt); }
+    std::size_t write(const void* buf, std::size_t cnt) { return 0; }
+
+    std::size_t read_at(void* buf, std::size_t cnt, boost::uint64_t at) {
+        return _seekable ? _dev->read_at(buf, cnt, at) : 0;
+    }
+
+    bool seek(boost::uint64_t at) {
+        ++seeks;
+        return _seekable && _dev->seek(at);
+    }
+
+private:
+    io_device_ptr _dev;
+    bool          _seekable;
+
+public:
+    int seeks;
+};
+
 void main() {
     const string in_dir="";  // directory of source images
     const std::string out_dir=in_dir+"image_io-out/";
@@ -75,14 +108,12 @@ void main() {
    }
 
    {
-      /* not supported, yet
       // RLE compressed
 
       rgb8_image_t image;
       bmp_read_image( in_dir+"g04rle.bmp", image);
 
       bmp_write_view( out_dir+"g04rle.bmp", view( image ));
-      */
    }
 
    {
@@ -136,14 +167,26 @@ void main() {
    }
 
    {
-      /* not supported, yet
       // RLE compressed.
 
       rgb8_image_t image;
       bmp_read_image( in_dir+"g08rle.bmp", image);
 
       bmp_write_view( out_dir+"g08rle.bmp", view( image ));
-      */
+   }
+
+   {
+      // RLE compressed, written back with RLE8 compression
+
+      gray8_image_t image;
+      bmp_read_image( in_dir+"g08rle.bmp", image);
+
+      bmp_write_view( out_dir+"g08rle_rle8.bmp", view( image ), bmp_compression_rle8 );
+
+      gray8_image_t image2;
+      bmp_read_image( out_dir+"g08rle_rle8.bmp", image2);
+
+      bmp_write_view( out_dir+"g08rle_rle8_read.bmp", view( image2 ));
    }
 
    {
@@ -304,6 +347,158 @@ void main() {
       bmp_write_view( out_dir+"g32bf.bmp", view( image ));
    }
 
+///////////////////
+// mapped images
+///////////////////
+   {
+      // 24-bit color (BGR), viewed in place without decoding
+
+      bmp_mapped_image< bgr8c_view_t > image( in_dir+"g24.bmp" );
+
+      bmp_write_view( out_dir+"g24_mapped.bmp", image.view() );
+   }
+
+   {
+      // 24-bit color (8 bits wasted), viewed in place without decoding
+
+      bmp_mapped_image< bgra8c_view_t > image( in_dir+"g32def.bmp" );
+
+      bmp_write_view( out_dir+"g32def_mapped.bmp", image.view() );
+   }
+
+///////////////////
+// regions of interest
+///////////////////
+   {
+      // 24-bit color (BGR), only a 32x16 region starting at (10,20) is read
+
+      rgb8_image_t image;
+      bmp_read_image( in_dir+"g24.bmp", image, 10, 20, 32, 16 );
+
+      bmp_write_view( out_dir+"g24_roi.bmp", view( image ));
+   }
+
+   {
+      // 1-bit, region starting inside a byte
+
+      gray8_image_t image( 50, 40 );
+      bmp_read_view( in_dir+"g01bw.bmp", view( image ), 3, 5 );
+
+      bmp_write_view( out_dir+"g01bw_roi.bmp", view( image ));
+   }
+
+   {
+      // 4-bit, region starting on an odd pixel
+
+      rgb8_image_t image;
+      bmp_read_image( in_dir+"g04.bmp", image, 7, 9, 31, 17 );
+
+      bmp_write_view( out_dir+"g04_roi.bmp", view( image ));
+   }
+
+   {
+      // a region reaching past the end of a truncated file fails instead of repeating rows
+
+      rgb8_image_t image;
+      bmp_read_image( in_dir+"g24.bmp", image );
+
+      std::vector< unsigned char > buf;
+      bmp_write_view( make_vector_device( buf ), view( image ));
+
+      FILE* fp = fopen( ( out_dir+"g24_cut.bmp" ).c_str(), "wb" );
+      fwrite( &buf.front(), 1, buf.size() / 2, fp );
+      fclose( fp );
+
+      bool failed = false;
+      try
+      {
+         bmp_read_image( out_dir+"g24_cut.bmp", image, 10, 0, 32, view( image ).height() );
+      }
+      catch( std::ios_base::failure& )
+      {
+         failed = true;
+      }
+      io_error_if( !failed, "region of a truncated file was read" );
+   }
+
+///////////////////
+// streamed writing
+///////////////////
+   {
+      // 24-bit color (BGR), written top-down in bands of 16 rows
+
+      rgb8_image_t image;
+      bmp_read_image( in_dir+"g24.bmp", image );
+
+      bmp_scanline_writer< rgb8_view_t > writer( out_dir+"g24_stream.bmp", view( image ).width(), view( image ).height() );
+
+      for( int y = 0; y < view( image ).height(); y += 16 )
+      {
+         int rows = std::min( 16, view( image ).height() - y );
+         writer.write_rows( subimage_view( view( image ), 0, y, view( image ).width(), rows ));
+      }
+      writer.finish();
+
+      bmp_read_image( out_dir+"g24_stream.bmp", image );
+      bmp_write_view( out_dir+"g24_stream_read.bmp", view( image ));
+   }
+
+///////////////////
+// header index
+///////////////////
+   {
+      // headers of several files read at once, the dimensions match the decoded images
+
+      std::vector< std::string > files;
+      files.push_back( in_dir+"g04rle.bmp" );
+      files.push_back( in_dir+"g08os2.bmp" );
+      files.push_back( in_dir+"g32bf.bmp"  );
+
+      std::vector< image_header_info > headers = read_image_headers( files, 2 );
+
+      for( std::size_t i = 0; i < headers.size(); ++i )
+      {
+         rgb8_image_t image;
+         bmp_read_image( headers[i].path, image );
+
+         io_error_if( headers[i].format != image_format_bmp
+                   || point2<int>( headers[i].width, headers[i].height ) != view( image ).dimensions()
+                    , "header index does not match the image" );
+      }
+   }
+
+///////////////////
+// parallel decoding
+///////////////////
+   {
+      // 24-bit color (BGR), decoded in four bands
+
+      rgb8_image_t image;
+      std::vector< bmp_band_timing > timings;
+      bmp_read_image_parallel( in_dir+"g24.bmp", image, 4, &timings );
+
+      bmp_write_view( out_dir+"g24_parallel.bmp", view( image ));
+   }
+
+   {
+      // 8-bit indexed, decoded with one band per core
+
+      rgb8_image_t image;
+      bmp_read_image_parallel( in_dir+"g08.bmp", image );
+
+      bmp_write_view( out_dir+"g08_parallel.bmp", view( image ));
+   }
+
+   {
+      // RLE files decode as one band, a reused timing vector keeps only that band
+
+      rgb8_image_t image;
+      std::vector< bmp_band_timing > timings( 3 );
+      bmp_read_image_parallel( in_dir+"g08rle.bmp", image, 4, &timings );
+
+      io_error_if( timings.size() != 1, "stale band timings after an RLE read" );
+   }
+
 
 // *********************************** 
 // ************************ PNM Test
@@ -374,5 +569,194 @@ void main() {
       pnm_read_image( out_dir+"p6.pnm", image );
       bmp_write_view( "p6.pnm.bmp", view( image ));
    }
+
+   {
+      // a PPMA file, samples parsed on four threads
+      rgb8_image_t image;
+      pnm_read_image_parallel( in_dir+"p3.pnm", image, 4 );
+
+      pnm_write_view( out_dir+"p3_parallel.pnm", view( image ));
+   }
+
+   {
+      // 16 bit samples, written with maximum value 65535 and read back
+      rgb16_image_t image;
+      pnm_read_image( in_dir+"p6.pnm", image );
+
+      pnm_write_view( out_dir+"p6_16.pnm", view( image ));
+
+      rgb16_image_t image_16;
+      pnm_read_image( out_dir+"p6_16.pnm", image_16 );
+
+      rgb8_image_t image_8;
+      pnm_read_image( out_dir+"p6_16.pnm", image_8 );
+      bmp_write_view( "p6_16.pnm.bmp", view( image_8 ));
+   }
+
+   {
+      gray16_image_t image;
+      pnm_read_image( in_dir+"p5.pnm", image );
+
+      pnm_write_view( out_dir+"p5_16.pnm", view( image ));
+      pnm_read_image( out_dir+"p5_16.pnm", image );
+   }
+
+   {
+      // concatenated frames, as a video decoder writes them to a pipe
+      const char* names[] = { "p6.pnm", "p6.pnm", "p5.pnm" };
+
+      FILE* out = fopen( ( out_dir+"frames.pnm" ).c_str(), "wb" );
+
+      for( int i = 0; i < 3; ++i )
+      {
+         FILE* in = fopen( ( in_dir+names[i] ).c_str(), "rb" );
+
+         for( int ch = fgetc( in ); ch != EOF; ch = fgetc( in ))
+         {
+            fputc( ch, out );
+         }
+         fclose( in );
+      }
+      fclose( out );
+
+      FILE* in = fopen( ( out_dir+"frames.pnm" ).c_str(), "rb" );
+
+      pnm_frame_reader< rgb8_image_t > frames( in );
+
+      while( frames.next() )
+      {
+         char name[32];
+         sprintf( name, "frame%i.pnm.bmp", frames.frames() );
+
+         bmp_write_view( name, frames.view() );
+      }
+      fclose( in );
+   }
+
+   {
+      // a PAM file keeps the alpha channel
+      rgba8_image_t image;
+      bmp_read_image( in_dir+"g32def.bmp", image );
+
+      pam_write_view( out_dir+"g32def.pam", view( image ));
+
+      rgba8_image_t image_pam;
+      pnm_read_image( out_dir+"g32def.pam", image_pam );
+      bmp_write_view( "g32def.pam.bmp", view( image_pam ));
+
+      rgba16_image_t image_16;
+      pnm_read_image( out_dir+"g32def.pam", image_16 );
+      pam_write_view( out_dir+"g32def_16.pam", view( image_16 ));
+   }
+
+   {
+      // bitmaps read and written one bit per pixel
+      gray1_image image;
+      pnm_read_image( in_dir+"p4.pnm", image );
+
+      pnm_write_view( out_dir+"p4_packed.pnm", image );
+      bmp_write_view( out_dir+"p4_packed.bmp", image );
+
+      bmp_read_image( in_dir+"g01wb.bmp", image );
+      bmp_write_view( out_dir+"g01wb_packed.bmp", image );
+   }
+
+   {
+      // a PPMB file viewed in place, copied into a mapped output file
+      pnm_mapped_image< rgb8c_view_t > image( in_dir+"p6.pnm" );
+
+      pnm_mapped_writer< rgb8_view_t > out( out_dir+"p6_mapped.pnm", image.dimensions().x, image.dimensions().y );
+
+      for( int y = 0; y < image.view().height(); ++y )
+      {
+         std::copy( image.view().row_begin( y ), image.view().row_end( y ), out.view().row_begin( y ));
+      }
+   }
+
+   {
+      // images decoded from and encoded into memory
+      rgb8_image_t image;
+      bmp_read_image( in_dir+"g24.bmp", image );
+
+      std::vector< unsigned char > buf;
+      bmp_write_view( make_vector_device( buf ), view( image ));
+
+      bmp_read_image( make_memory_device( &buf.front(), buf.size() ), image );
+      pnm_write_view( out_dir+"memory.pnm", view( image ));
+
+      pnm_read_image( make_mapped_device( ( out_dir+"memory.pnm" ).c_str() ), image );
+      bmp_write_view( "memory.pnm.bmp", view( image ));
+   }
+
+   {
+      // files read ahead on a background thread while decoding
+      rgb8_image_t image;
+      bmp_read_image( make_read_ahead_device( in_dir+"g24.bmp", 4096, 2 ), image );
+      bmp_write_view( "g24_ahead.bmp", view( image ));
+
+      pnm_read_image( make_read_ahead_device( in_dir+"p6.pnm" ), image );
+      pnm_write_view( out_dir+"p6_ahead.pnm", view( image ));
+   }
+
+   {
+      // reading ahead never seeks the file back, the raster follows the headers or is already queued
+      const char* files[] = { "g24.bmp", "g08offs.bmp" };
+
+      for( int i = 0; i < 2; ++i )
+      {
+         FILE* fp = fopen( ( in_dir+files[i] ).c_str(), "rb" );
+         io_error_if( fp == NULL, "failed to open file" );
+
+         counting_device* file = new counting_device( io_device_ptr( new detail::stdio_device( fp, true )), true );
+         io_device_ptr    dev( file );
+
+         rgb8_image_t image;
+         bmp_read_image( make_read_ahead_device( dev, 4096, 2 ), image );
+
+         io_error_if( file->seeks != 0, "read ahead device seeked the file" );
+      }
+   }
+
+   {
+      // files that can't seek decode as long as the headers are followed by the raster
+      const char* files[] = { "g24.bmp", "g08.bmp", "g32bf.bmp" };
+
+      for( int i = 0; i < 3; ++i )
+      {
+         rgb8_image_t image, piped;
+         bmp_read_image( in_dir+files[i], image );
+         bmp_read_image( io_device_ptr( new counting_device( make_mapped_device( ( in_dir+files[i] ).c_str() ), false )), piped );
+
+         for( int y = 0; y < view( image ).height(); ++y )
+         {
+            io_error_if( !std::equal( view( image ).row_begin( y ), view( image ).row_end( y ), view( piped ).row_begin( y ))
+                       , "BMP file decoded differently without seeking" );
+         }
+      }
+   }
+
+   {
+      // run-time typed images take the type matching the file layout, bgr8 for 24 bit files
+      any_image< bmp_types_t > image;
+
+      io_error_if( bmp_read_image( in_dir+"g24.bmp", image ) != io_conversion_none
+                 , "g24.bmp was not read into a matching layout" );
+      bmp_write_view( "g24_any.bmp", view( image ));
+
+      any_image< pnm_types_t > image_pnm;
+      pnm_read_image( in_dir+"p6.pnm", image_pnm );
+      pnm_write_view( out_dir+"p6_any.pnm", view( image_pnm ));
+   }
+
+   {
+      // files of either format read without knowing which one they are
+      any_image< bmp_types_t > image;
+
+      read_any_image( in_dir+"g08.bmp", image );
+      bmp_write_view( "g08_any.bmp", view( image ));
+
+      read_any_image( in_dir+"p5.pnm", image );
+      bmp_write_view( "p5_any.bmp", view( image ));
+   }
 }
 
@@ -0,0 +1,236 @@
+// bmp_pnm_benchmark.cpp : Measures the BMP and PNM row conversions.
+//
+// Every row kernel runs once in its plain C++ version and once in the version
+// picked for this CPU. Throughput is given in MB/s of destination bytes.
+
+#include <cstdio>
+#include <ctime>
+#include <string>
+#include <vector>
+
+#include <gil/core/image_view.hpp>
+#include <gil/core/typedefs.hpp>
+
+#include <gil/extension/io/bmp_io.hpp>
+#include <gil/extension/io/pnm_io.hpp>
+#include <gil/extension/io/row_convert.hpp>
+
+using namespace GIL;
+using namespace std;
+
+/// Runs fn over a w x h raster for rep times and returns destination MB/s
+static double measure( detail::row_kernel fn, int src_bpp, int dest_bpp, int w, int h, int rep )
+{
+   vector< detail::byte_t > src ( w * src_bpp  );
+   vector< detail::byte_t > dest( w * dest_bpp );
+
+   for( size_t i = 0; i < src.size(); ++i )
+   {
+      src[i] = detail::byte_t( i * 7 + 3 );
+   }
+
+   clock_t start = clock();
+
+   for( int r = 0; r < rep; ++r )
+   {
+      for( int y = 0; y < h; ++y )
+      {
+         fn( &src.front(), &dest.front(), w );
+      }
+   }
+
+   double sec = double( clock() - start ) / CLOCKS_PER_SEC;
+   double mb  = double( dest.size() ) * h * rep / ( 1024.0 * 1024.0 );
+
+   return ( sec > 0 ) ? mb / sec : 0;
+}
+
+static void report( const char* name, detail::row_kernel plain, detail::row_kernel fast, int src_bpp, int dest_bpp )
+{
+   const int w   = 4096;
+   const int h   = 1024;
+   const int rep = 8;
+
+   double a = measure( plain, src_bpp, dest_bpp, w, h, rep );
+   double b = measure( fast , src_bpp, dest_bpp, w, h, rep );
+
+   printf( "%-28s %10.1f MB/s %10.1f MB/s   x%.2f\n", name, a, b, ( a > 0 ) ? b / a : 0 );
+}
+
+/// Times decoding a file into a view of type IMAGE with bmp_read_image or pnm_read_image
+template< typename IMAGE >
+static void report_read( const char* name, const string& file, void (*read)( const string&, IMAGE& ), int rep )
+{
+   IMAGE image;
+
+   clock_t start = clock();
+
+   for( int r = 0; r < rep; ++r )
+   {
+      read( file, image );
+   }
+
+   double sec = double( clock() - start ) / CLOCKS_PER_SEC;
+   double mb  = double( view( image ).width() ) * view( image ).height() * sizeof( typename IMAGE::view_t::pixel_t ) * rep / ( 1024.0 * 1024.0 );
+
+   printf( "%-28s %10.1f MB/s\n", name, ( sec > 0 ) ? mb / sec : 0 );
+}
+
+/// Writes the pnm file in tiled scale x scale times as a binary PGM or PPM whose samples are rescaled
+/// to maxv, two bytes per sample above 255
+static void write_tiled( const string& in, const string& out, int scale, int maxv, bool gray )
+{
+   rgb8_image_t image;
+   pnm_read_image( in, image );
+
+   rgb8_view_t v = view( image );
+
+   const int w = v.width()  * scale;
+   const int h = v.height() * scale;
+
+   FILE* fp = fopen( out.c_str(), "wb" );
+
+   if( fp == NULL )
+   {
+      return;
+   }
+
+   fprintf( fp, "P%i %i %i %i\n", gray ? 5 : 6, w, h, maxv );
+
+   vector< unsigned char > row;
+
+   for( int y = 0; y < h; ++y )
+   {
+      row.clear();
+
+      for( int x = 0; x < w; ++x )
+      {
+         const rgb8_pixel_t& p = v( x % v.width(), y % v.height() );
+
+         int samples[] = { p.red, p.green, p.blue };
+
+         for( int c = gray ? 1 : 0; c < ( gray ? 2 : 3 ); ++c )
+         {
+            int s = samples[c] * maxv / 255;
+
+            if( maxv > 255 )
+               row.push_back( (unsigned char)( s >> 8 ));
+
+            row.push_back( (unsigned char)( s ));
+         }
+      }
+
+      fwrite( &row.front(), 1, row.size(), fp );
+   }
+
+   fclose( fp );
+}
+
+/// Times encoding a view of type IMAGE as a bmp file
+template< typename IMAGE >
+static void report_write( const char* name, const string& file, int rep )
+{
+   IMAGE image( 4096, 4096 );
+
+   clock_t start = clock();
+
+   for( int r = 0; r < rep; ++r )
+   {
+      bmp_write_view( file, view( image ));
+   }
+
+   double sec = double( clock() - start ) / CLOCKS_PER_SEC;
+   double mb  = double( view( image ).width() ) * view( image ).height() * sizeof( typename IMAGE::view_t::pixel_t ) * rep / ( 1024.0 * 1024.0 );
+
+   printf( "%-28s %10.1f MB/s\n", name, ( sec > 0 ) ? mb / sec : 0 );
+}
+
+int main()
+{
+   const std::string in_dir  = "";  // directory of source images
+   const std::string out_dir = "image_io-out/";
+
+   detail::row_kernels plain = detail::scalar_row_kernels();
+   detail::row_kernels fast  = detail::get_row_kernels();
+
+   int features = detail::cpu_features();
+
+   printf( "cpu:%s%s%s\n\n"
+         , ( features & detail::cpu_sse2  ) ? " sse2"  : ""
+         , ( features & detail::cpu_ssse3 ) ? " ssse3" : ""
+         , ( features & detail::cpu_avx2  ) ? " avx2"  : "" );
+
+   printf( "%-28s %15s %15s\n", "kernel", "plain", "dispatched" );
+
+   report( "BGR -> RGB (bmp read)"   , plain.swap_rb_24  , fast.swap_rb_24  , 3, 3 );
+   report( "BGR* -> RGBA (bmp read)" , plain.bgrx_to_rgba, fast.bgrx_to_rgba, 4, 4 );
+   report( "5-5-5 -> RGB (bmp read)" , plain.unpack_555  , fast.unpack_555  , 2, 3 );
+   report( "5-6-5 -> RGB (bmp read)" , plain.unpack_565  , fast.unpack_565  , 2, 3 );
+   report( "gray -> RGB (pnm read)"  , plain.gray_to_rgb , fast.gray_to_rgb , 1, 3 );
+   report( "gray -> RGBA (pnm read)" , plain.gray_to_rgba, fast.gray_to_rgba, 1, 4 );
+   report( "RGB -> BGR (bmp write)"  , plain.swap_rb_24  , fast.swap_rb_24  , 3, 3 );
+   report( "RGBA -> BGR* (bmp write)", plain.rgba_to_bgrx, fast.rgba_to_bgrx, 4, 4 );
+   report( "RGBA -> RGB (pnm write)" , plain.rgba_to_rgb , fast.rgba_to_rgb , 4, 3 );
+
+   // whole file decoding
+   printf( "\n%-28s %15s\n", "file", "decode" );
+
+   {
+      rgb8_image_t image( 4096, 4096 );
+      bmp_write_view( out_dir + "bench24.bmp", view( image ));
+      pnm_write_view( out_dir + "bench.ppm"  , view( image ));
+   }
+
+   {
+      rgba8_image_t image( 4096, 4096 );
+      bmp_write_view( out_dir + "bench32.bmp", view( image ));
+   }
+
+   {
+      gray8_image_t image( 4096, 4096 );
+      bmp_write_view( out_dir + "bench08.bmp", view( image ));
+   }
+
+   report_read< rgb8_image_t  >( "24 bit bmp -> rgb8" , out_dir + "bench24.bmp", &bmp_read_image, 4 );
+   report_read< bgr8_image_t  >( "24 bit bmp -> bgr8" , out_dir + "bench24.bmp", &bmp_read_image, 4 );
+   report_read< rgba8_image_t >( "32 bit bmp -> rgba8", out_dir + "bench32.bmp", &bmp_read_image, 4 );
+   report_read< gray8_image_t >( "8 bit bmp -> gray8" , out_dir + "bench08.bmp", &bmp_read_image, 4 );
+   report_read< rgb8_image_t  >( "8 bit bmp -> rgb8"  , out_dir + "bench08.bmp", &bmp_read_image, 4 );
+   report_read< rgb8_image_t  >( "ppm -> rgb8"        , out_dir + "bench.ppm"  , &pnm_read_image, 4 );
+
+   // pnm sample rescaling, the test images tiled to about 4000 x 4000
+   printf( "\n%-28s %15s\n", "pnm file", "decode" );
+
+   write_tiled( in_dir + "p5.pnm" , out_dir + "bench_p5_255.pgm"  , 20, 255  , true  );
+   write_tiled( in_dir + "p5.pnm" , out_dir + "bench_p5_100.pgm"  , 20, 100  , true  );
+   write_tiled( in_dir + "p5.pnm" , out_dir + "bench_p5_4095.pgm" , 20, 4095 , true  );
+   write_tiled( in_dir + "p5.pnm" , out_dir + "bench_p5_65535.pgm", 20, 65535, true  );
+   write_tiled( in_dir + "p6.pnm" , out_dir + "bench_p6_255.ppm"  , 16, 255  , false );
+   write_tiled( in_dir + "p6.pnm" , out_dir + "bench_p6_100.ppm"  , 16, 100  , false );
+   write_tiled( in_dir + "p6.pnm" , out_dir + "bench_p6_4095.ppm" , 16, 4095 , false );
+   write_tiled( in_dir + "rgb.pnm", out_dir + "bench_rgb_1.pgm"   , 20, 1    , true  );
+   write_tiled( in_dir + "rgb.pnm", out_dir + "bench_rgb_255.ppm" , 20, 255  , false );
+
+   report_read< gray8_image_t  >( "p5 255 -> gray8"    , out_dir + "bench_p5_255.pgm"  , &pnm_read_image, 4 );
+   report_read< gray8_image_t  >( "p5 100 -> gray8"    , out_dir + "bench_p5_100.pgm"  , &pnm_read_image, 4 );
+   report_read< gray8_image_t  >( "p5 4095 -> gray8"   , out_dir + "bench_p5_4095.pgm" , &pnm_read_image, 4 );
+   report_read< gray16_image_t >( "p5 4095 -> gray16"  , out_dir + "bench_p5_4095.pgm" , &pnm_read_image, 4 );
+   report_read< gray16_image_t >( "p5 65535 -> gray16" , out_dir + "bench_p5_65535.pgm", &pnm_read_image, 4 );
+   report_read< rgb8_image_t   >( "p6 255 -> rgb8"     , out_dir + "bench_p6_255.ppm"  , &pnm_read_image, 4 );
+   report_read< rgb8_image_t   >( "p6 100 -> rgb8"     , out_dir + "bench_p6_100.ppm"  , &pnm_read_image, 4 );
+   report_read< bgr8_image_t   >( "p6 100 -> bgr8"     , out_dir + "bench_p6_100.ppm"  , &pnm_read_image, 4 );
+   report_read< rgb8_image_t   >( "p6 4095 -> rgb8"    , out_dir + "bench_p6_4095.ppm" , &pnm_read_image, 4 );
+   report_read< rgb16_image_t  >( "p6 4095 -> rgb16"   , out_dir + "bench_p6_4095.ppm" , &pnm_read_image, 4 );
+   report_read< gray8_image_t  >( "rgb 1 -> gray8"     , out_dir + "bench_rgb_1.pgm"   , &pnm_read_image, 4 );
+   report_read< rgb8_image_t   >( "rgb 255 -> rgb8"    , out_dir + "bench_rgb_255.ppm" , &pnm_read_image, 4 );
+
+   // whole file encoding
+   printf( "\n%-28s %15s\n", "file", "encode" );
+
+   report_write< bgr8_image_t  >( "bgr8 -> 24 bit bmp" , out_dir + "bench24.bmp", 4 );
+   report_write< rgb8_image_t  >( "rgb8 -> 24 bit bmp" , out_dir + "bench24.bmp", 4 );
+   report_write< rgba8_image_t >( "rgba8 -> 32 bit bmp", out_dir + "bench32.bmp", 4 );
+   report_write< gray8_image_t >( "gray8 -> 8 bit bmp" , out_dir + "bench08.bmp", 4 );
+
+   return 0;
+}
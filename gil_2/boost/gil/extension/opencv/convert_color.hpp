@@ -36,6 +36,9 @@
 #include <boost/utility/enable_if.hpp>
 
 #include "ipl_image_wrapper.hpp"
+#ifdef BOOST_GIL_OPENCV_USE_MAT
+#include "mat_wrapper.hpp"
+#endif
 
 namespace boost { namespace gil { namespace opencv {
 
@@ -332,10 +335,27 @@ void cvtcolor_impl( const ipl_image_wrapper& src
                                              >::type* ptr = 0
                   )
 {
+#ifdef BOOST_GIL_OPENCV_USE_MAT
+
+    cv::Mat dst_mat = create_cv_mat( dst );
+
+    const uchar* data = dst_mat.data;
+
+    cv::cvtColor( create_cv_mat( src )
+                , dst_mat
+                , Is_Supported::code
+                );
+
+    detail::check_cv_mat( dst_mat, data );
+
+#else
+
     cvCvtColor( src.get()
               , dst.get()
               , Is_Supported::code
               );
+
+#endif
 }
 
 template< typename View_Src
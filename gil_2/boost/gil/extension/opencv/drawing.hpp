@@ -34,7 +34,8 @@ struct cv_aa : boost::mpl::int_< CV_AA > {};
 
 
 /// When chaining operators we don't want to reconvert to
-/// ipl_image all the time.
+/// ipl_image all the time. Wrap the view once with create_ipl_image
+/// and pass the ipl_image_wrapper to every draw call of the chain.
 
 /// rectangle
 
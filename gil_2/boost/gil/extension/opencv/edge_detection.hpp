@@ -24,6 +24,9 @@
 #include <boost/utility/enable_if.hpp>
 
 #include "ipl_image_wrapper.hpp"
+#ifdef BOOST_GIL_OPENCV_USE_MAT
+#include "mat_wrapper.hpp"
+#endif
 
 namespace boost { namespace gil { namespace opencv {
 
@@ -49,12 +52,32 @@ void sobel( const ipl_image_wrapper& src
                                      >::type* ptr = 0
           )
 {
+#ifdef BOOST_GIL_OPENCV_USE_MAT
+
+   cv::Mat dst_mat = create_cv_mat( dst );
+
+   const uchar* data = dst_mat.data;
+
+   cv::Sobel( create_cv_mat( src )
+            , dst_mat
+            , dst_mat.depth()
+            , static_cast< int >( x_order )
+            , static_cast< int >( y_order )
+            , Aperture::type::value
+            );
+
+   detail::check_cv_mat( dst_mat, data );
+
+#else
+
    cvSobel( src.get()
           , dst.get()
           , x_order
           , y_order
           , Aperture::type::value
           );
+
+#endif
 }
 
 template< typename View
@@ -0,0 +1,89 @@
+/*
+    Copyright 2008 Christian Henning
+    Use, modification and distribution are subject to the Boost Software License,
+    Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+    http://www.boost.org/LICENSE_1_0.txt).
+*/
+
+/*************************************************************************************************/
+
+#ifndef BOOST_GIL_EXTENSION_OPENCV_FILTER_BARRIER_HPP_INCLUDED
+#define BOOST_GIL_EXTENSION_OPENCV_FILTER_BARRIER_HPP_INCLUDED
+
+////////////////////////////////////////////////////////////////////////////////////////
+/// \file
+/// \brief Barrier between reading and writing the views of the native filters.
+/// \author Christian Henning \n
+///
+/// \date 2008 \n
+///
+////////////////////////////////////////////////////////////////////////////////////////
+
+#include <cstddef>
+
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+namespace boost { namespace gil { namespace opencv {
+
+namespace detail {
+
+/// Lets the threads of a filter go on once all of them got there. Unlike
+/// boost::barrier the count can be lowered afterwards, for when starting a
+/// thread failed while others already wait. Every thread waits only once.
+class filter_barrier : boost::noncopyable
+{
+public:
+
+    filter_barrier( std::size_t count )
+    : _count( count )
+    , _waiting( 0 )
+    {}
+
+    void wait()
+    {
+        boost::mutex::scoped_lock lock( _mutex );
+
+        ++_waiting;
+
+        if( _waiting >= _count )
+        {
+            _all.notify_all();
+        }
+
+        while( _waiting < _count )
+        {
+            _all.wait( lock );
+        }
+    }
+
+    /// Sets the number of threads to wait for, which only started ones count in.
+    void set_count( std::size_t count )
+    {
+        boost::mutex::scoped_lock lock( _mutex );
+
+        _count = count;
+
+        if( _waiting >= _count )
+        {
+            _all.notify_all();
+        }
+    }
+
+private:
+
+    boost::mutex              _mutex;
+    boost::condition_variable _all;
+
+    std::size_t _count;
+    std::size_t _waiting;
+};
+
+} // namespace detail
+
+} // namespace opencv
+} // namespace gil
+} // namespace boost
+
+#endif // BOOST_GIL_EXTENSION_OPENCV_FILTER_BARRIER_HPP_INCLUDED
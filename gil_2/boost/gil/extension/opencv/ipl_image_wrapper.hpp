@@ -19,7 +19,12 @@
 ///
 ////////////////////////////////////////////////////////////////////////////////////////
 
+#include <climits>
+#include <stdexcept>
+#include <vector>
+
 #include <boost\shared_ptr.hpp>
+#include <boost\static_assert.hpp>
 #include <boost\gil\gil_all.hpp>
 
 #include "utilities.hpp"
@@ -41,6 +46,11 @@ template<> struct ipl_channel_type< bits32s > : boost::mpl::int_< IPL_DEPTH_32S
  * ipl_image_wrapper encloses a IplImage pointer. Value semantics, like
  * copying, are supported by using shared_ptr.
  *
+ * Headers made by create_ipl_image are held by value inside the wrapper,
+ * so wrapping a view allocates nothing. Copies of such a wrapper carry their
+ * own copy of the header, pointing at the same pixels. Don't set an OpenCV
+ * ROI on them with cvSetImageROI, which allocates; wrap a subimage_view instead.
+ *
  **/
 class ipl_image_wrapper
 {
@@ -49,11 +59,13 @@ public:
     typedef boost::shared_ptr< IplImage > ipl_image_ptr_t;
 
 public:
-    ipl_image_wrapper() {}
-    ipl_image_wrapper( IplImage* img ) : _img( img, ipl_deleter ) {}
+    ipl_image_wrapper() : _header() {}
+    ipl_image_wrapper( IplImage* img ) : _img( img, ipl_deleter ), _header() {}
+
+    explicit ipl_image_wrapper( const IplImage& header ) : _header( header ) {}
 
-    IplImage*       get()       { return _img.get(); }
-    const IplImage* get() const { return _img.get(); }
+    IplImage*       get()       { return _img ? _img.get() : ( _header.nSize ? &_header : NULL ); }
+    const IplImage* get() const { return _img ? _img.get() : ( _header.nSize ? &_header : NULL ); }
 
 private:
 
@@ -66,29 +78,99 @@ private:
     }
 
    ipl_image_ptr_t _img;
+   IplImage        _header;
 };
 
+namespace detail {
+
+/// Bytes from one row of the view to the next, as IplImage::widthStep. Views of a
+/// larger image, such as subimage_view, keep the row step of the whole image.
 template< typename View >
 inline
-ipl_image_wrapper create_ipl_image( View view )
+int ipl_width_step( const View& view )
 {
     typedef typename channel_type< View >::type channel_t;
 
-    IplImage* img;
+    std::ptrdiff_t step = view.pixels().row_size();
+
+    // IplImage rows must follow each other top to bottom, without overlapping
+    if( step < static_cast< std::ptrdiff_t >( view.width() * sizeof( channel_t ) * ( is_planar< View >::value ? 1 : num_channels< View >::value ))
+     || step > INT_MAX
+      )
+    {
+        throw std::runtime_error( "Cannot create IPL image with the row step of the view." );
+    }
+
+    return static_cast< int >( step );
+}
 
-    if(( img = cvCreateImageHeader( make_cvSize( view.dimensions() )
-                                  , ipl_channel_type<channel_t>::type::value
-                                  , num_channels<View>::value
-                                  )) == NULL )
+/// Creates a header of the given number of channels over data laid out with the given row step
+template< typename Channel >
+inline
+ipl_image_wrapper create_ipl_header( point_t dimensions
+                                   , int     channels
+                                   , void*   data
+                                   , int     step
+                                   )
+{
+    IplImage header;
+
+    if( cvInitImageHeader( &header
+                         , make_cvSize( dimensions )
+                         , ipl_channel_type< Channel >::type::value
+                         , channels
+                         ) == NULL )
     {
         throw std::runtime_error( "Cannot create IPL image." );
     }
 
-    cvSetData( img
-             , interleaved_view_get_raw_data( view )
-             , num_channels<View>::value * view.width() * sizeof( channel_t ) );
+    cvSetData( &header, data, step );
+
+    return ipl_image_wrapper( header );
+}
+
+} // namespace detail
+
+/// Wraps the pixels of an interleaved view without copying them. The view may be part of
+/// a larger image or have padded rows; the IplImage gets the view's own row step.
+template< typename View >
+inline
+ipl_image_wrapper create_ipl_image( View view )
+{
+    typedef typename channel_type< View >::type channel_t;
+
+    return detail::create_ipl_header< channel_t >( view.dimensions()
+                                                 , num_channels< View >::value
+                                                 , interleaved_view_get_raw_data( view )
+                                                 , detail::ipl_width_step( view )
+                                                 );
+}
+
+/// Wraps every plane of a planar view in a one channel IplImage, without copying the pixels.
+/// OpenCV functions working on one channel of interest take the header of that plane.
+template< typename View >
+inline
+std::vector< ipl_image_wrapper > create_ipl_planes( View view )
+{
+    BOOST_STATIC_ASSERT(( is_planar< View >::value ));
+
+    typedef typename channel_type< View >::type channel_t;
+
+    int step = detail::ipl_width_step( view );
+
+    std::vector< ipl_image_wrapper > planes;
+    planes.reserve( num_channels< View >::value );
+
+    for( int i = 0; i < num_channels< View >::value; ++i )
+    {
+        planes.push_back( detail::create_ipl_header< channel_t >( view.dimensions()
+                                                                , 1
+                                                                , planar_view_get_raw_data( view, i )
+                                                                , step
+                                                                ));
+    }
 
-    return ipl_image_wrapper( img );
+    return planes;
 }
 
 } // namespace opencv
@@ -0,0 +1,98 @@
+/*
+    Copyright 2008 Christian Henning
+    Use, modification and distribution are subject to the Boost Software License,
+    Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+    http://www.boost.org/LICENSE_1_0.txt).
+*/
+
+/*************************************************************************************************/
+
+#ifndef BOOST_GIL_EXTENSION_OPENCV_MAT_WRAPPER_HPP_INCLUDED
+#define BOOST_GIL_EXTENSION_OPENCV_MAT_WRAPPER_HPP_INCLUDED
+
+////////////////////////////////////////////////////////////////////////////////////////
+/// \file
+/// \brief cv::Mat headers over gil views, for OpenCV's C++ API.
+/// \author Christian Henning \n
+///
+/// \date 2008 \n
+///
+/// Define BOOST_GIL_OPENCV_USE_MAT to have smooth, resize, sobel and cvtcolor
+/// call the C++ functions, which run on OpenCV's parallel back end, instead
+/// of the C ones. Call sites don't change. The other headers include this one
+/// only then, so the extension still builds against a C-only OpenCV.
+///
+////////////////////////////////////////////////////////////////////////////////////////
+
+#include "ipl_image_wrapper.hpp"
+
+namespace boost { namespace gil { namespace opencv {
+
+template < typename Channel > struct cv_channel_type : boost::mpl::false_ {};
+template<> struct cv_channel_type< bits8 >   : boost::mpl::int_< CV_8U  > {};
+template<> struct cv_channel_type< bits16 >  : boost::mpl::int_< CV_16U > {};
+template<> struct cv_channel_type< bits32f > : boost::mpl::int_< CV_32F > {};
+template<> struct cv_channel_type< double >  : boost::mpl::int_< CV_64F > {};
+template<> struct cv_channel_type< bits8s >  : boost::mpl::int_< CV_8S  > {};
+template<> struct cv_channel_type< bits16s > : boost::mpl::int_< CV_16S > {};
+template<> struct cv_channel_type< bits32s > : boost::mpl::int_< CV_32S > {};
+
+/// Makes a cv::Mat over the pixels of an interleaved view without copying them.
+/// Like create_ipl_image, the matrix gets the view's own row step.
+template< typename View >
+inline
+cv::Mat create_cv_mat( View view )
+{
+    typedef typename channel_type< View >::type channel_t;
+
+    return cv::Mat( static_cast< int >( view.height() )
+                  , static_cast< int >( view.width()  )
+                  , CV_MAKETYPE( cv_channel_type< channel_t >::type::value
+                               , num_channels< View >::value
+                               )
+                  , interleaved_view_get_raw_data( view )
+                  , detail::ipl_width_step( view )
+                  );
+}
+
+/// Makes a cv::Mat over the pixels of a wrapped IplImage without copying them.
+inline
+cv::Mat create_cv_mat( const ipl_image_wrapper& ipl_image )
+{
+    return cv::cvarrToMat( ipl_image.get() );
+}
+
+namespace detail {
+
+/// OpenCV's C++ functions give the destination matrix new memory when its
+/// type or size doesn't fit the result, which then never reaches the view.
+inline
+void check_cv_mat( const cv::Mat& dst, const uchar* data )
+{
+    if( dst.data != data )
+    {
+        throw std::runtime_error( "Destination view doesn't fit the type or size of the result." );
+    }
+}
+
+} // namespace detail
+
+/// Sets the number of threads OpenCV's C++ functions use. 0 runs them
+/// sequentially, a negative number restores the default.
+inline
+void set_num_threads( int num_threads )
+{
+    cv::setNumThreads( num_threads );
+}
+
+inline
+int get_num_threads()
+{
+    return cv::getNumThreads();
+}
+
+} // namespace opencv
+} // namespace gil
+} // namespace boost
+
+#endif // BOOST_GIL_EXTENSION_OPENCV_MAT_WRAPPER_HPP_INCLUDED
@@ -0,0 +1,445 @@
+/*
+    Copyright 2008 Christian Henning
+    Use, modification and distribution are subject to the Boost Software License,
+    Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+    http://www.boost.org/LICENSE_1_0.txt).
+*/
+
+/*************************************************************************************************/
+
+#ifndef BOOST_GIL_EXTENSION_OPENCV_MEDIAN_FILTER_HPP_INCLUDED
+#define BOOST_GIL_EXTENSION_OPENCV_MEDIAN_FILTER_HPP_INCLUDED
+
+////////////////////////////////////////////////////////////////////////////////////////
+/// \file
+/// \brief Median filter for 8 bit views whose cost doesn't grow with the kernel size.
+/// \author Christian Henning \n
+///
+/// \date 2008 \n
+///
+/// Follows Perreault and Hebert, "Median Filtering in Constant Time". Every
+/// column keeps a histogram of the kernel height pixels around the current row.
+/// Moving right, the kernel histogram adds the column entering the kernel and
+/// drops the one leaving it, whatever the kernel width. A coarse histogram of
+/// 16 bins finds the part of the fine histogram the median is in.
+///
+////////////////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/type_traits/is_same.hpp>
+#include <boost/gil/gil_all.hpp>
+
+#include "filter_barrier.hpp"
+
+namespace boost { namespace gil { namespace opencv {
+
+namespace detail {
+
+/// Copies the channels of a pixel into consecutive bytes.
+struct get_channels
+{
+    get_channels( bits8*& p ) : _p( p ) {}
+
+    template< typename Channel >
+    void operator()( const Channel& c ) const { *_p++ = c; }
+
+    bits8*& _p;
+};
+
+/// Sets the channels of a pixel from consecutive bytes.
+struct set_channels
+{
+    set_channels( const bits8*& p ) : _p( p ) {}
+
+    template< typename Channel >
+    void operator()( Channel& c ) const { c = *_p++; }
+
+    const bits8*& _p;
+};
+
+/// Fine and coarse histogram of one channel.
+struct median_histogram
+{
+    boost::uint16_t fine  [256];
+    boost::uint16_t coarse[16];
+};
+
+/// Kernel histogram of one channel. Only the part of the fine histogram the
+/// median is in gets updated, when it is needed; updated tells the column each
+/// part is up to date for.
+struct median_kernel
+{
+    boost::uint16_t fine   [256];
+    boost::uint16_t coarse [16];
+    int             updated[16];
+};
+
+/// Filters the columns [x0,x1) of the destination. The source columns the
+/// kernel reaches outside of the strip are copied before any strip writes,
+/// and the source rows still needed are kept, so strips may run in parallel
+/// on the same view.
+template< typename SrcView
+        , typename DstView
+        >
+class median_strip : boost::noncopyable
+{
+public:
+
+    median_strip( const SrcView& src
+                , const DstView& dst
+                , int            radius
+                , int            x0
+                , int            x1
+                )
+    : _src( src )
+    , _dst( dst )
+    , _r ( radius )
+    , _w ( static_cast< int >( src.width()  ))
+    , _h ( static_cast< int >( src.height() ))
+    , _nc( num_channels< SrcView >::value )
+    , _x0( x0 )
+    , _x1( x1 )
+    , _c0( (std::max)( x0 - radius, 0  ))
+    , _c1( (std::min)( x1 + radius, _w ))
+    , _halo( ( _x0 - _c0 + _c1 - _x1 ) * _h * _nc )
+    , _ring( ( 2 * radius + 2 ) * ( _c1 - _c0 ) * _nc )
+    , _columns( ( _c1 - _c0 ) * _nc )
+    , _kernel( _nc )
+    , _out( ( _x1 - _x0 ) * _nc )
+    {}
+
+    /// Copies the source columns left and right of the strip.
+    void prepare()
+    {
+        bits8* p = _halo.empty() ? 0 : &_halo[0];
+
+        for( int y = 0; y < _h; ++y )
+        {
+            typename SrcView::x_iterator it = _src.row_begin( y );
+
+            for( int x = _c0; x < _x0; ++x ) { static_for_each( it[x], get_channels( p )); }
+            for( int x = _x1; x < _c1; ++x ) { static_for_each( it[x], get_channels( p )); }
+        }
+    }
+
+    void run()
+    {
+        const int n    = 2 * _r + 1;
+        const int rank = n * n / 2;
+
+        std::fill( _columns.begin(), _columns.end(), median_histogram() );
+
+        // rows outside of the image repeat the first or the last one
+        for( int y = -_r; y < _r; ++y )
+        {
+            add_row( (std::min)( (std::max)( y, 0 ), _h - 1 ));
+        }
+
+        for( int y = 0; y < _h; ++y )
+        {
+            add_row( (std::min)( y + _r, _h - 1 ));
+
+            // columns outside of the image repeat the first or the last one
+            for( int c = 0; c < _nc; ++c )
+            {
+                median_kernel& k = _kernel[c];
+
+                std::fill( k.coarse, k.coarse + 16, 0 );
+
+                for( int x = _x0 - _r; x <= _x0 + _r; ++x )
+                {
+                    add( k.coarse, column( x, c ).coarse, 16 );
+                }
+
+                std::fill( k.updated, k.updated + 16, _x0 - n - 1 );
+            }
+
+            bits8* out = &_out[0];
+
+            for( int x = _x0; x < _x1; ++x )
+            {
+                for( int c = 0; c < _nc; ++c )
+                {
+                    median_kernel& k = _kernel[c];
+
+                    if( x > _x0 )
+                    {
+                        add( k.coarse, column( x + _r    , c ).coarse, 16 );
+                        sub( k.coarse, column( x - _r - 1, c ).coarse, 16 );
+                    }
+
+                    *out++ = median( k, x, c, rank );
+                }
+            }
+
+            typedef typename DstView::value_type dst_pixel_t;
+
+            typename DstView::x_iterator it = _dst.row_begin( y );
+
+            const bits8* p = &_out[0];
+
+            for( int x = _x0; x < _x1; ++x )
+            {
+                dst_pixel_t pixel;
+                static_for_each( pixel, set_channels( p ));
+
+                it[x] = pixel;
+            }
+
+            remove_row( (std::max)( y - _r, 0 ));
+        }
+    }
+
+private:
+
+    const median_histogram& column( int x, int c ) const
+    {
+        return _columns[ ( (std::min)( (std::max)( x, 0 ), _w - 1 ) - _c0 ) * _nc + c ];
+    }
+
+    bits8* ring_row( int y ) { return &_ring[ ( y % ( 2 * _r + 2 )) * ( _c1 - _c0 ) * _nc ]; }
+
+    /// Reads a source row into the ring and adds it to the column histograms.
+    void add_row( int y )
+    {
+        bits8* row = ring_row( y );
+        bits8* p   = row;
+
+        const int halo = _x0 - _c0 + _c1 - _x1;
+
+        const bits8* left  = halo ? &_halo[ y * halo * _nc ] : 0;
+        const bits8* right = halo ? left + ( _x0 - _c0 ) * _nc : 0;
+
+        typename SrcView::x_iterator it = _src.row_begin( y );
+
+        p = std::copy( left, left + ( _x0 - _c0 ) * _nc, p );
+
+        for( int x = _x0; x < _x1; ++x )
+        {
+            static_for_each( it[x], get_channels( p ));
+        }
+
+        std::copy( right, right + ( _c1 - _x1 ) * _nc, p );
+
+        update_columns( row, 1 );
+    }
+
+    /// Drops a row, kept in the ring, from the column histograms.
+    void remove_row( int y )
+    {
+        update_columns( ring_row( y ), -1 );
+    }
+
+    void update_columns( const bits8* row, int sign )
+    {
+        const int n = ( _c1 - _c0 ) * _nc;
+
+        for( int i = 0; i < n; ++i )
+        {
+            _columns[i].fine  [ row[i]      ] += sign;
+            _columns[i].coarse[ row[i] >> 4 ] += sign;
+        }
+    }
+
+    static void add( boost::uint16_t* k, const boost::uint16_t* h, int n )
+    {
+        for( int i = 0; i < n; ++i ) { k[i] += h[i]; }
+    }
+
+    static void sub( boost::uint16_t* k, const boost::uint16_t* h, int n )
+    {
+        for( int i = 0; i < n; ++i ) { k[i] -= h[i]; }
+    }
+
+    /// Median of the kernel centered on column x
+    bits8 median( median_kernel& k, int x, int c, int rank ) const
+    {
+        int sum = 0;
+        int b   = 0;
+
+        while( sum + k.coarse[b] <= rank )
+        {
+            sum += k.coarse[b++];
+        }
+
+        boost::uint16_t* fine = k.fine + b * 16;
+
+        if( x - k.updated[b] > 2 * _r + 1 )
+        {
+            // cheaper to sum the kernel columns again
+            std::fill( fine, fine + 16, 0 );
+
+            for( int i = x - _r; i <= x + _r; ++i )
+            {
+                add( fine, column( i, c ).fine + b * 16, 16 );
+            }
+        }
+        else
+        {
+            for( int i = k.updated[b] + 1; i <= x; ++i )
+            {
+                add( fine, column( i + _r    , c ).fine + b * 16, 16 );
+                sub( fine, column( i - _r - 1, c ).fine + b * 16, 16 );
+            }
+        }
+
+        k.updated[b] = x;
+
+        int i = 0;
+
+        while( sum + fine[i] <= rank )
+        {
+            sum += fine[i++];
+        }
+
+        return static_cast< bits8 >( b * 16 + i );
+    }
+
+    SrcView _src;
+    DstView _dst;
+
+    int _r, _w, _h, _nc, _x0, _x1, _c0, _c1;
+
+    std::vector< bits8 >            _halo;      ///< source columns outside the strip
+    std::vector< bits8 >            _ring;      ///< source rows in the column histograms
+    std::vector< median_histogram > _columns;   ///< per source column and channel
+    std::vector< median_kernel >    _kernel;    ///< per channel
+    std::vector< bits8 >            _out;       ///< medians of the current row
+};
+
+template< typename Strip >
+inline
+void run_median_strips( boost::ptr_vector< Strip >& strips
+                      , std::size_t                 first
+                      , std::size_t                 step
+                      , filter_barrier&             ready
+                      )
+{
+    for( std::size_t i = first; i < strips.size(); i += step )
+    {
+        strips[i].prepare();
+    }
+
+    ready.wait();
+
+    for( std::size_t i = first; i < strips.size(); i += step )
+    {
+        strips[i].run();
+    }
+}
+
+} // namespace detail
+
+/// Median filter like cvSmooth with CV_MEDIAN, for views with 8 bit channels.
+/// The kernel size is odd and at most 255. Borders replicate the edge pixels.
+/// Columns strips sized for the second level cache run on up to num_threads
+/// threads; num_threads 0 uses all cores. The source may be the destination.
+template< typename SrcView
+        , typename DstView
+        >
+inline
+void median_filter( const SrcView& src
+                  , const DstView& dst
+                  , std::size_t    kernel_size
+                  , std::size_t    num_threads = 0
+                  )
+{
+    BOOST_STATIC_ASSERT(( num_channels< SrcView >::value == num_channels< DstView >::value ));
+    BOOST_STATIC_ASSERT(( boost::is_same< typename channel_type< SrcView >::type, bits8 >::value ));
+
+    if( src.dimensions() != dst.dimensions() )
+    {
+        throw std::runtime_error( "Source and destination views must have the same dimensions." );
+    }
+
+    if( kernel_size % 2 == 0 || kernel_size > 255 )
+    {
+        throw std::runtime_error( "Median kernel size must be odd and at most 255." );
+    }
+
+    if( src.width() == 0 || src.height() == 0 )
+    {
+        return;
+    }
+
+    const int w      = static_cast< int >( src.width() );
+    const int radius = static_cast< int >( kernel_size / 2 );
+
+    // column histograms of a strip take about 256 KB
+    const int columns = ( 1 << 18 ) / ( num_channels< SrcView >::value * sizeof( detail::median_histogram ));
+    const int width   = (std::max)( columns - 2 * radius, 32 );
+
+    typedef detail::median_strip< SrcView, DstView > strip_t;
+
+    boost::ptr_vector< strip_t > strips;
+
+    for( int x = 0; x < w; x += width )
+    {
+        strips.push_back( new strip_t( src, dst, radius, x, (std::min)( x + width, w )));
+    }
+
+    if( num_threads == 0 )
+    {
+        num_threads = (std::max)( boost::thread::hardware_concurrency(), 1u );
+    }
+
+    num_threads = (std::min)( num_threads, strips.size() );
+
+    detail::filter_barrier ready( num_threads );
+    boost::thread_group    threads;
+
+    std::size_t started = 1;
+
+    try
+    {
+        for( ; started < num_threads; ++started )
+        {
+            threads.create_thread( boost::bind( &detail::run_median_strips< strip_t >
+                                              , boost::ref( strips )
+                                              , started
+                                              , num_threads
+                                              , boost::ref( ready )
+                                              ));
+        }
+    }
+    catch( ... )
+    {
+        // the strips left without a thread run on this one, prepared
+        // before any strip writes
+        for( std::size_t i = 0; i < strips.size(); ++i )
+        {
+            if( i % num_threads >= started )
+            {
+                strips[i].prepare();
+            }
+        }
+
+        ready.set_count( started );
+    }
+
+    detail::run_median_strips( strips, 0, num_threads, ready );
+
+    for( std::size_t i = 0; i < strips.size(); ++i )
+    {
+        if( i % num_threads >= started )
+        {
+            strips[i].run();
+        }
+    }
+
+    threads.join_all();
+}
+
+} // namespace opencv
+} // namespace gil
+} // namespace boost
+
+#endif // BOOST_GIL_EXTENSION_OPENCV_MEDIAN_FILTER_HPP_INCLUDED
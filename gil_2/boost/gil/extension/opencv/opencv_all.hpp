@@ -23,7 +23,13 @@
 #include "convert_scale.hpp"
 #include "drawing.hpp"
 #include "edge_detection.hpp"
+#include "filter_barrier.hpp"
+#ifdef BOOST_GIL_OPENCV_USE_MAT
+#include "mat_wrapper.hpp"
+#endif
+#include "median_filter.hpp"
 #include "resize.hpp"
+#include "separable_filter.hpp"
 #include "smooth.hpp"
 #include "text.hpp"
 #include "utilities.hpp"
@@ -20,6 +20,9 @@
 ////////////////////////////////////////////////////////////////////////////////////////
 
 #include "ipl_image_wrapper.hpp"
+#ifdef BOOST_GIL_OPENCV_USE_MAT
+#include "mat_wrapper.hpp"
+#endif
 
 namespace boost { namespace gil { namespace opencv {
 
@@ -40,10 +43,30 @@ void resize( const ipl_image_wrapper& src
                                       >::type* ptr = 0
            )
 {
+#ifdef BOOST_GIL_OPENCV_USE_MAT
+
+   cv::Mat dst_mat = create_cv_mat( dst );
+
+   const uchar* data = dst_mat.data;
+
+   cv::resize( create_cv_mat( src )
+             , dst_mat
+             , dst_mat.size()
+             , 0
+             , 0
+             , Interpolation::type::value
+             );
+
+   detail::check_cv_mat( dst_mat, data );
+
+#else
+
    cvResize( src.get()
            , dst.get()
            , Interpolation::type::value
            );
+
+#endif
 }
 
 template< typename View
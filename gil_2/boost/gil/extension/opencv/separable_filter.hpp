@@ -0,0 +1,669 @@
+/*
+    Copyright 2008 Christian Henning
+    Use, modification and distribution are subject to the Boost Software License,
+    Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+    http://www.boost.org/LICENSE_1_0.txt).
+*/
+
+/*************************************************************************************************/
+
+#ifndef BOOST_GIL_EXTENSION_OPENCV_SEPARABLE_FILTER_HPP_INCLUDED
+#define BOOST_GIL_EXTENSION_OPENCV_SEPARABLE_FILTER_HPP_INCLUDED
+
+////////////////////////////////////////////////////////////////////////////////////////
+/// \file
+/// \brief Gaussian and box filters working on gil views, without OpenCV.
+/// \author Christian Henning \n
+///
+/// \date 2008 \n
+///
+/// The filters are separable: every source row is filtered horizontally once,
+/// the vertical pass combines the rows the kernel covers. 8 bit channels are
+/// filtered in fixed point, all others in floating point. Borders replicate
+/// the edge pixels, like cvSmooth does. Any view works, including planar and
+/// bit aligned ones, and the source may be the destination.
+///
+////////////////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/bind.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/type_traits/is_floating_point.hpp>
+#include <boost/type_traits/is_integral.hpp>
+#include <boost/gil/gil_all.hpp>
+
+#include "filter_barrier.hpp"
+
+namespace boost { namespace gil { namespace opencv {
+
+namespace detail {
+
+/// Type the filters sum a channel in. Float holds integers up to 2^24 exactly,
+/// which unnormalized sums of 16 bit channels and 32 bit channels exceed.
+template< typename Value > struct filter_accumulator { typedef float  type; };
+template<> struct filter_accumulator< bits8   >      { typedef int    type; };
+template<> struct filter_accumulator< bits8s  >      { typedef int    type; };
+template<> struct filter_accumulator< bits16  >      { typedef double type; };
+template<> struct filter_accumulator< bits16s >      { typedef double type; };
+template<> struct filter_accumulator< bits32  >      { typedef double type; };
+template<> struct filter_accumulator< bits32s >      { typedef double type; };
+template<> struct filter_accumulator< double  >      { typedef double type; };
+
+/// Channel type the accumulator is chosen by; bit aligned pixels may mix channel sizes.
+template< typename View >
+struct filter_channel
+{
+    typedef typename channel_traits< typename kth_element_type< typename View::value_type, 0 >::type >::value_type type;
+};
+
+/// Tells whether results are rounded to whole channel values.
+template< typename Value > struct is_integral_channel : boost::is_integral< Value > {};
+template< int NumBits > struct is_integral_channel< packed_channel_value< NumBits > > : boost::mpl::true_ {};
+
+/// Horizontal and vertical kernel, and the scale applied to their result.
+template< typename Acc >
+struct filter_kernel
+{
+    std::vector< Acc > x;
+    std::vector< Acc > y;
+
+    // result = ( sum + 2^(shift-1) ) >> shift if shift isn't 0, sum * scale otherwise
+    int    shift;
+    double scale;
+};
+
+/// Accumulators the passes work on at once.
+const int filter_chunk = 1024;
+
+/// Fraction bits of the fixed point weights of each pass. 8 bit sums of both
+/// passes stay below 2^28.
+const int filter_fraction_bits = 10;
+
+/// Weights scaled to 2^filter_fraction_bits in total, the rounding error goes to the center weight.
+inline
+std::vector< int > quantize_kernel( const std::vector< double >& k )
+{
+    std::vector< int > q( k.size() );
+
+    int sum = 0;
+    for( std::size_t i = 0; i < k.size(); ++i )
+    {
+        q[i] = static_cast< int >( std::floor( std::ldexp( k[i], filter_fraction_bits ) + 0.5 ));
+        sum += q[i];
+    }
+
+    q[ k.size() / 2 ] += ( 1 << filter_fraction_bits ) - sum;
+
+    return q;
+}
+
+inline
+bool is_whole( const std::vector< double >& k )
+{
+    for( std::size_t i = 0; i < k.size(); ++i )
+    {
+        if( k[i] != std::floor( k[i] ))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+template< typename Acc >
+inline
+void make_filter_kernel( const std::vector< double >& x
+                       , const std::vector< double >& y
+                       , double                       scale
+                       , filter_kernel< Acc >&        kernel
+                       , boost::mpl::true_            // integral accumulator
+                       )
+{
+    if( is_whole( x ) && is_whole( y ))
+    {
+        kernel.x.assign( x.begin(), x.end() );
+        kernel.y.assign( y.begin(), y.end() );
+    }
+    else
+    {
+        std::vector< int > qx = quantize_kernel( x );
+        std::vector< int > qy = quantize_kernel( y );
+
+        kernel.x.assign( qx.begin(), qx.end() );
+        kernel.y.assign( qy.begin(), qy.end() );
+
+        kernel.shift = 2 * filter_fraction_bits;
+        kernel.scale = 1;
+
+        return;
+    }
+
+    kernel.shift = 0;
+    kernel.scale = scale;
+}
+
+template< typename Acc >
+inline
+void make_filter_kernel( const std::vector< double >& x
+                       , const std::vector< double >& y
+                       , double                       scale
+                       , filter_kernel< Acc >&        kernel
+                       , boost::mpl::false_           // floating point accumulator
+                       )
+{
+    kernel.x.assign( x.begin(), x.end() );
+    kernel.y.assign( y.begin(), y.end() );
+
+    kernel.shift = 0;
+    kernel.scale = scale;
+}
+
+/// Same kernel as OpenCV's getGaussianKernel.
+inline
+std::vector< double > gaussian_kernel( int size, double sigma )
+{
+    static const double small_kernels[4][7] = { { 1 }
+                                              , { 0.25, 0.5, 0.25 }
+                                              , { 0.0625, 0.25, 0.375, 0.25, 0.0625 }
+                                              , { 0.03125, 0.109375, 0.21875, 0.28125, 0.21875, 0.109375, 0.03125 }
+                                              };
+
+    std::vector< double > k( size );
+
+    if( size <= 7 && sigma <= 0 )
+    {
+        std::copy( small_kernels[ size / 2 ], small_kernels[ size / 2 ] + size, k.begin() );
+
+        return k;
+    }
+
+    if( sigma <= 0 )
+    {
+        sigma = 0.3 * (( size - 1 ) * 0.5 - 1 ) + 0.8;
+    }
+
+    double sum = 0;
+    for( int i = 0; i < size; ++i )
+    {
+        double d = i - ( size - 1 ) * 0.5;
+
+        k[i] = std::exp( -d * d / ( 2 * sigma * sigma ));
+        sum += k[i];
+    }
+
+    for( int i = 0; i < size; ++i )
+    {
+        k[i] /= sum;
+    }
+
+    return k;
+}
+
+/// Copies the channels of a pixel into consecutive accumulators.
+template< typename Acc >
+struct unpack_channels
+{
+    unpack_channels( Acc*& p ) : _p( p ) {}
+
+    template< typename Channel >
+    void operator()( const Channel& c ) const
+    {
+        *_p++ = static_cast< Acc >( c );
+    }
+
+    Acc*& _p;
+};
+
+/// Sets the channels of a pixel from consecutive scaled filter sums.
+template< typename Acc >
+struct pack_channels
+{
+    pack_channels( const Acc*& p ) : _p( p ) {}
+
+    template< typename Channel >
+    void operator()( Channel& c ) const
+    {
+        c = result< typename channel_traits< Channel >::value_type >( *_p++ );
+    }
+
+    // packed channels are set through proxies
+    template< typename Channel >
+    void operator()( const Channel& c ) const
+    {
+        c = result< typename channel_traits< Channel >::value_type >( *_p++ );
+    }
+
+private:
+
+    template< typename Value >
+    Value result( Acc v ) const
+    {
+        if( is_integral_channel< Value >::value && !boost::is_integral< Acc >::value )
+        {
+            v = static_cast< Acc >( std::floor( v + Acc( 0.5 )));
+        }
+
+        // plain float and double channels have no range
+        if( !boost::is_floating_point< Value >::value )
+        {
+            v = (std::max)( v, static_cast< Acc >( channel_traits< Value >::min_value() ));
+            v = (std::min)( v, static_cast< Acc >( channel_traits< Value >::max_value() ));
+        }
+
+        return Value( static_cast< typename boost::mpl::if_< is_integral_channel< Value >
+                                                           , boost::int64_t
+                                                           , double
+                                                           >::type
+                                  >( v ));
+    }
+
+    const Acc*& _p;
+};
+
+/// Filters the rows [y0,y1) of the destination. The rows the kernel reaches
+/// outside of the band are filtered horizontally before any band writes, so
+/// bands may run in parallel on the same view.
+template< typename SrcView
+        , typename DstView
+        , typename Acc
+        >
+class filter_band : boost::noncopyable
+{
+public:
+
+    filter_band( const SrcView&              src
+               , const DstView&              dst
+               , const filter_kernel< Acc >& kernel
+               , int                         y0
+               , int                         y1
+               )
+    : _src( src )
+    , _dst( dst )
+    , _kernel( kernel )
+    , _w ( static_cast< int >( src.width()  ))
+    , _h ( static_cast< int >( src.height() ))
+    , _nc( num_channels< SrcView >::value )
+    , _kw( static_cast< int >( kernel.x.size() ))
+    , _kh( static_cast< int >( kernel.y.size() ))
+    , _y0( y0 )
+    , _y1( y1 )
+    , _ring( _kh * _w * _nc )
+    , _tail( (std::max)( _kh - 1 - _kh / 2, 0 ) * _w * _nc )
+    , _row ( ( _w + _kw - 1 ) * _nc )
+    , _sum ( _w * _nc )
+    {}
+
+    /// Filters the rows above and below the band.
+    void prepare()
+    {
+        _next = (std::max)( _y0 - _kh / 2, 0 );
+
+        for( ; _next < _y0; ++_next )
+        {
+            filter_row( _next, slot( _next ));
+        }
+
+        for( int y = _y1; y < (std::min)( _y1 + _kh - 1 - _kh / 2, _h ); ++y )
+        {
+            filter_row( y, &_tail[ ( y - _y1 ) * _w * _nc ] );
+        }
+    }
+
+    void run()
+    {
+        const int n = _w * _nc;
+
+        std::vector< const Acc* > rows( _kh );
+
+        for( int y = _y0; y < _y1; ++y )
+        {
+            int top = y - _kh / 2;
+
+            for( ; _next <= (std::min)( top + _kh - 1, _y1 - 1 ); ++_next )
+            {
+                filter_row( _next, slot( _next ));
+            }
+
+            for( int i = 0; i < _kh; ++i )
+            {
+                rows[i] = filtered( (std::min)( (std::max)( top + i, 0 ), _h - 1 ));
+            }
+
+            Acc* sum = &_sum[0];
+
+            // vertical pass, in chunks which stay in the first level cache
+            // while all kernel rows are added
+            for( int j0 = 0; j0 < n; j0 += filter_chunk )
+            {
+                const int j1 = (std::min)( j0 + filter_chunk, n );
+
+                std::fill( sum + j0, sum + j1, Acc( 0 ));
+
+                for( int i = 0; i < _kh; ++i )
+                {
+                    const Acc  k   = _kernel.y[i];
+                    const Acc* row = rows[i];
+
+                    for( int j = j0; j < j1; ++j )
+                    {
+                        sum[j] += k * row[j];
+                    }
+                }
+            }
+
+            scale( sum, n, boost::mpl::bool_< boost::is_integral< Acc >::value >() );
+
+            typedef typename DstView::value_type dst_pixel_t;
+
+            typename DstView::x_iterator it = _dst.row_begin( y );
+
+            const Acc* p = &_sum[0];
+
+            for( int x = 0; x < _w; ++x )
+            {
+                dst_pixel_t pixel;
+                static_for_each( pixel, pack_channels< Acc >( p ));
+
+                it[x] = pixel;
+            }
+        }
+    }
+
+private:
+
+    Acc* slot( int y ) { return &_ring[ ( y % _kh ) * _w * _nc ]; }
+
+    /// Horizontally filtered row y, from the ring or from below the band.
+    const Acc* filtered( int y )
+    {
+        return ( y < _y1 ) ? slot( y ) : &_tail[ ( y - _y1 ) * _w * _nc ];
+    }
+
+    void scale( Acc* sum, int n, boost::mpl::true_ ) const
+    {
+        if( _kernel.shift )
+        {
+            const Acc half = Acc( 1 ) << ( _kernel.shift - 1 );
+
+            for( int j = 0; j < n; ++j )
+            {
+                sum[j] = ( sum[j] + half ) >> _kernel.shift;
+            }
+        }
+        else if( _kernel.scale != 1 )
+        {
+            const double s = _kernel.scale;
+
+            for( int j = 0; j < n; ++j )
+            {
+                sum[j] = static_cast< Acc >( std::floor( sum[j] * s + 0.5 ));
+            }
+        }
+    }
+
+    void scale( Acc* sum, int n, boost::mpl::false_ ) const
+    {
+        if( _kernel.scale != 1 )
+        {
+            const Acc s = static_cast< Acc >( _kernel.scale );
+
+            for( int j = 0; j < n; ++j )
+            {
+                sum[j] *= s;
+            }
+        }
+    }
+
+    /// Horizontal pass over one source row.
+    void filter_row( int y, Acc* out )
+    {
+        typename SrcView::x_iterator it = _src.row_begin( y );
+
+        Acc* p = &_row[0];
+
+        for( int t = 0; t < _w + _kw - 1; ++t )
+        {
+            int x = (std::min)( (std::max)( t - _kw / 2, 0 ), _w - 1 );
+
+            static_for_each( it[x], unpack_channels< Acc >( p ));
+        }
+
+        const int n = _w * _nc;
+
+        for( int j0 = 0; j0 < n; j0 += filter_chunk )
+        {
+            const int j1 = (std::min)( j0 + filter_chunk, n );
+
+            std::fill( out + j0, out + j1, Acc( 0 ));
+
+            for( int i = 0; i < _kw; ++i )
+            {
+                const Acc  k  = _kernel.x[i];
+                const Acc* in = &_row[ i * _nc ];
+
+                for( int j = j0; j < j1; ++j )
+                {
+                    out[j] += k * in[j];
+                }
+            }
+        }
+    }
+
+    SrcView                     _src;
+    DstView                     _dst;
+    const filter_kernel< Acc >& _kernel;
+
+    int _w, _h, _nc, _kw, _kh, _y0, _y1, _next;
+
+    std::vector< Acc > _ring;   ///< horizontally filtered rows, one per kernel row
+    std::vector< Acc > _tail;   ///< filtered rows below the band
+    std::vector< Acc > _row;    ///< source row with replicated borders
+    std::vector< Acc > _sum;    ///< vertical sums of the current row
+};
+
+template< typename Band >
+inline
+void run_filter_band( Band& band, filter_barrier& ready )
+{
+    band.prepare();
+    ready.wait();
+    band.run();
+}
+
+/// Filters src into dst with the kernels, in row bands on up to num_threads threads.
+template< typename SrcView
+        , typename DstView
+        >
+inline
+void separable_filter( const SrcView&               src
+                     , const DstView&               dst
+                     , const std::vector< double >& kernel_x
+                     , const std::vector< double >& kernel_y
+                     , double                       scale
+                     , std::size_t                  num_threads
+                     )
+{
+    BOOST_STATIC_ASSERT(( num_channels< SrcView >::value == num_channels< DstView >::value ));
+
+    if( src.dimensions() != dst.dimensions() )
+    {
+        throw std::runtime_error( "Source and destination views must have the same dimensions." );
+    }
+
+    if( src.width() == 0 || src.height() == 0 )
+    {
+        return;
+    }
+
+    typedef typename filter_channel< SrcView >::type channel_t;
+    typedef typename filter_accumulator< channel_t >::type acc_t;
+
+    filter_kernel< acc_t > kernel;
+    make_filter_kernel( kernel_x, kernel_y, scale, kernel, boost::mpl::bool_< boost::is_integral< acc_t >::value >() );
+
+    if( num_threads == 0 )
+    {
+        num_threads = (std::max)( boost::thread::hardware_concurrency(), 1u );
+    }
+
+    // bands of fewer rows don't pay for their thread
+    const int min_band_rows = 64;
+
+    const int h     = static_cast< int >( src.height() );
+    const int bands = static_cast< int >( (std::min)( num_threads
+                                                    , static_cast< std::size_t >( (std::max)( h / min_band_rows, 1 ))
+                                                    ));
+
+    typedef filter_band< SrcView, DstView, acc_t > band_t;
+
+    boost::ptr_vector< band_t > band;
+
+    for( int b = 0; b < bands; ++b )
+    {
+        band.push_back( new band_t( src, dst, kernel, h * b / bands, h * ( b + 1 ) / bands ));
+    }
+
+    if( bands == 1 )
+    {
+        band[0].prepare();
+        band[0].run();
+
+        return;
+    }
+
+    filter_barrier      ready( bands );
+    boost::thread_group threads;
+
+    int started = 1;
+
+    try
+    {
+        for( ; started < bands; ++started )
+        {
+            threads.create_thread( boost::bind( &run_filter_band< band_t >, boost::ref( band[started] ), boost::ref( ready )));
+        }
+    }
+    catch( ... )
+    {
+        // the bands left without a thread run on this one, prepared
+        // before any band writes
+        for( int b = started; b < bands; ++b )
+        {
+            band[b].prepare();
+        }
+
+        ready.set_count( started );
+    }
+
+    run_filter_band( band[0], ready );
+
+    for( int b = started; b < bands; ++b )
+    {
+        band[b].run();
+    }
+
+    threads.join_all();
+}
+
+} // namespace detail
+
+/// Gaussian blur like cvSmooth with CV_GAUSSIAN. A kernel size of 0 is computed
+/// from sigma, a kernel height of 0 is the width, sigma 0 is computed from the
+/// kernel size and sigma_y 0 is sigma_x. Kernel sizes must be odd.
+/// num_threads 0 uses all cores.
+template< typename SrcView
+        , typename DstView
+        >
+inline
+void gaussian_filter( const SrcView& src
+                    , const DstView& dst
+                    , std::size_t    kernel_width
+                    , std::size_t    kernel_height = 0
+                    , double         sigma_x       = 0
+                    , double         sigma_y       = 0
+                    , std::size_t    num_threads   = 0
+                    )
+{
+    typedef typename detail::filter_channel< SrcView >::type channel_t;
+
+    if( sigma_y <= 0 )
+    {
+        sigma_y = sigma_x;
+    }
+
+    // same as cvSmooth
+    const double sigma_size = ( sizeof( channel_t ) == 1 ? 3 : 4 ) * 2;
+
+    if( kernel_width == 0 && sigma_x > 0 )
+    {
+        kernel_width = static_cast< std::size_t >( std::floor( sigma_x * sigma_size + 1.5 )) | 1;
+    }
+
+    if( kernel_height == 0 )
+    {
+        kernel_height = ( sigma_y > 0 && sigma_y != sigma_x )
+                      ? static_cast< std::size_t >( std::floor( sigma_y * sigma_size + 1.5 )) | 1
+                      : kernel_width;
+    }
+
+    if( kernel_width % 2 == 0 || kernel_height % 2 == 0 )
+    {
+        throw std::runtime_error( "Gaussian kernel sizes must be odd." );
+    }
+
+    detail::separable_filter( src
+                            , dst
+                            , detail::gaussian_kernel( static_cast< int >( kernel_width  ), sigma_x )
+                            , detail::gaussian_kernel( static_cast< int >( kernel_height ), sigma_y )
+                            , 1.0
+                            , num_threads
+                            );
+}
+
+/// Box blur like cvSmooth with CV_BLUR, or CV_BLUR_NO_SCALE if normalize is false.
+/// Unscaled sums are clamped to the range of the destination channel.
+/// A kernel height of 0 is the width. num_threads 0 uses all cores.
+template< typename SrcView
+        , typename DstView
+        >
+inline
+void box_filter( const SrcView& src
+               , const DstView& dst
+               , std::size_t    kernel_width
+               , std::size_t    kernel_height = 0
+               , bool           normalize     = true
+               , std::size_t    num_threads   = 0
+               )
+{
+    if( kernel_height == 0 )
+    {
+        kernel_height = kernel_width;
+    }
+
+    if( kernel_width == 0 )
+    {
+        throw std::runtime_error( "Box kernel sizes must be positive." );
+    }
+
+    detail::separable_filter( src
+                            , dst
+                            , std::vector< double >( kernel_width , 1.0 )
+                            , std::vector< double >( kernel_height, 1.0 )
+                            , normalize ? 1.0 / ( kernel_width * kernel_height ) : 1.0
+                            , num_threads
+                            );
+}
+
+} // namespace opencv
+} // namespace gil
+} // namespace boost
+
+#endif // BOOST_GIL_EXTENSION_OPENCV_SEPARABLE_FILTER_HPP_INCLUDED
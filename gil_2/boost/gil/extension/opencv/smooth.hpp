@@ -20,10 +20,16 @@
 ////////////////////////////////////////////////////////////////////////////////////////
 
 #include <boost/type_traits/is_base_of.hpp>
+#include <boost/type_traits/is_same.hpp>
 
 #include <boost/utility/enable_if.hpp>
 
 #include "ipl_image_wrapper.hpp"
+#ifdef BOOST_GIL_OPENCV_USE_MAT
+#include "mat_wrapper.hpp"
+#endif
+#include "median_filter.hpp"
+#include "separable_filter.hpp"
 
 namespace boost { namespace gil { namespace opencv {
 
@@ -50,6 +56,71 @@ void smooth( const ipl_image_wrapper& src
            )
            
 {
+#ifdef BOOST_GIL_OPENCV_USE_MAT
+
+   cv::Mat src_mat = create_cv_mat( src );
+   cv::Mat dst_mat = create_cv_mat( dst );
+
+   const uchar* data = dst_mat.data;
+
+   // the same as cvSmooth does
+   cv::Size size( static_cast< int >( param1 )
+                , static_cast< int >( param2 ? param2 : param1 )
+                );
+
+   switch( Smooth::type::value )
+   {
+      case CV_BLUR_NO_SCALE:
+      case CV_BLUR:
+      {
+         cv::boxFilter( src_mat
+                      , dst_mat
+                      , dst_mat.depth()
+                      , size
+                      , cv::Point( -1, -1 )
+                      , Smooth::type::value == CV_BLUR
+                      , cv::BORDER_REPLICATE
+                      );
+         break;
+      }
+
+      case CV_GAUSSIAN:
+      {
+         cv::GaussianBlur( src_mat
+                         , dst_mat
+                         , size
+                         , static_cast< double >( param3 )
+                         , static_cast< double >( param4 )
+                         , cv::BORDER_REPLICATE
+                         );
+         break;
+      }
+
+      case CV_MEDIAN:
+      {
+         cv::medianBlur( src_mat
+                       , dst_mat
+                       , static_cast< int >( param1 )
+                       );
+         break;
+      }
+
+      default:
+      {
+         cv::bilateralFilter( src_mat
+                            , dst_mat
+                            , static_cast< int >( param1 )
+                            , static_cast< double >( param3 )
+                            , static_cast< double >( param4 )
+                            , cv::BORDER_REPLICATE
+                            );
+      }
+   }
+
+   detail::check_cv_mat( dst_mat, data );
+
+#else
+
    cvSmooth( src.get()
            , dst.get()
            , Smooth::type::value
@@ -58,8 +129,142 @@ void smooth( const ipl_image_wrapper& src
            , param3
            , param4
            );
+
+#endif
 }
 
+namespace detail {
+
+template< typename View
+        , typename Smooth
+        >
+inline
+void smooth_view( View          src
+                , View          dst
+                , const Smooth& smooth_type
+                , size_t        param1
+                , size_t        param2
+                , size_t        param3
+                , size_t        param4
+                )
+{
+    ipl_image_wrapper src_ipl = create_ipl_image( src );
+    ipl_image_wrapper dst_ipl = create_ipl_image( dst );
+
+    smooth( src_ipl
+          , dst_ipl
+          , smooth_type
+          , param1
+          , param2
+          , param3
+          , param4
+          );
+}
+
+// Gaussian and box blurs don't need OpenCV.
+
+template< typename View >
+inline
+void smooth_view( View            src
+                , View            dst
+                , const gaussian&
+                , size_t          param1
+                , size_t          param2
+                , size_t          param3
+                , size_t          param4
+                )
+{
+    gaussian_filter( src
+                   , dst
+                   , param1
+                   , param2
+                   , static_cast< double >( param3 )
+                   , static_cast< double >( param4 )
+                   );
+}
+
+template< typename View >
+inline
+void smooth_view( View        src
+                , View        dst
+                , const blur&
+                , size_t      param1
+                , size_t      param2
+                , size_t
+                , size_t
+                )
+{
+    box_filter( src, dst, param1, param2, true );
+}
+
+template< typename View >
+inline
+void smooth_view( View                 src
+                , View                 dst
+                , const blur_no_scale&
+                , size_t               param1
+                , size_t               param2
+                , size_t
+                , size_t
+                )
+{
+    box_filter( src, dst, param1, param2, false );
+}
+
+// 8 bit medians don't need OpenCV either.
+
+template< typename View >
+inline
+void smooth_median( View   src
+                  , View   dst
+                  , size_t param1
+                  , boost::mpl::true_ // 8 bit channels
+                  )
+{
+    median_filter( src, dst, param1 );
+}
+
+template< typename View >
+inline
+void smooth_median( View   src
+                  , View   dst
+                  , size_t param1
+                  , boost::mpl::false_
+                  )
+{
+    ipl_image_wrapper src_ipl = create_ipl_image( src );
+    ipl_image_wrapper dst_ipl = create_ipl_image( dst );
+
+    smooth( src_ipl
+          , dst_ipl
+          , median()
+          , param1
+          );
+}
+
+template< typename View >
+inline
+void smooth_view( View          src
+                , View          dst
+                , const median&
+                , size_t        param1
+                , size_t
+                , size_t
+                , size_t
+                )
+{
+    smooth_median( src
+                 , dst
+                 , param1
+                 , typename boost::mpl::bool_< boost::is_same< typename channel_type< View >::type
+                                                             , bits8
+                                                             >::value
+                                             >::type()
+                 );
+}
+
+} // namespace detail
+
 template< typename View
         , typename Smooth
         >
@@ -76,13 +281,14 @@ void smooth( View          src
                                       >::type* ptr = 0
            )
 {
-    ipl_image_wrapper src_ipl = create_ipl_image( src );
-    ipl_image_wrapper dst_ipl = create_ipl_image( dst );
-
-    smooth( src_ipl
-          , dst_ipl
-          , smooth_type
-          );
+    detail::smooth_view( src
+                       , dst
+                       , smooth_type
+                       , param1
+                       , param2
+                       , param3
+                       , param4
+                       );
 }
 
 } // namespace opencv
@@ -41,4 +41,49 @@ BOOST_AUTO_TEST_CASE( test_value_semantics )
     ipl_image_wrapper ipl_img_2( ipl_img );
 
     return;
-}
\ No newline at end of file
+}
+
+BOOST_AUTO_TEST_CASE( test_subimage_view )
+{
+    rgb8_image_t img( 640, 480 );
+    fill_pixels( view( img ), rgb8_pixel_t( 255, 255, 255 ) );
+
+    rgb8_view_t sub = subimage_view( view( img ), 10, 20, 100, 50 );
+
+    ipl_image_wrapper ipl_img = create_ipl_image( sub );
+
+    BOOST_CHECK_EQUAL( ipl_img.get()->width    , 100     );
+    BOOST_CHECK_EQUAL( ipl_img.get()->height   , 50      );
+    BOOST_CHECK_EQUAL( ipl_img.get()->widthStep, 640 * 3 );
+    BOOST_CHECK( ipl_img.get()->imageData == (char*) &sub( 0, 0 ));
+}
+
+BOOST_AUTO_TEST_CASE( test_planar_view )
+{
+    rgb8_planar_image_t img( 640, 480 );
+
+    std::vector< ipl_image_wrapper > planes = create_ipl_planes( subimage_view( view( img ), 10, 20, 100, 50 ));
+
+    BOOST_CHECK_EQUAL( planes.size(), 3 );
+
+    for( std::size_t i = 0; i < planes.size(); ++i )
+    {
+        BOOST_CHECK_EQUAL( planes[i].get()->nChannels, 1   );
+        BOOST_CHECK_EQUAL( planes[i].get()->widthStep, 640 );
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_header_copy )
+{
+    rgb8_image_t img( 640, 480 );
+
+    ipl_image_wrapper ipl_img = create_ipl_image( view( img ));
+
+    ipl_image_wrapper ipl_img_2( ipl_img );
+
+    BOOST_CHECK( ipl_img_2.get() != ipl_img.get() );
+    BOOST_CHECK( ipl_img_2.get()->imageData == ipl_img.get()->imageData );
+    BOOST_CHECK_EQUAL( ipl_img_2.get()->widthStep, 640 * 3 );
+
+    BOOST_CHECK( ipl_image_wrapper().get() == NULL );
+}
@@ -0,0 +1,52 @@
+#include "stdafx.h"
+
+#include <boost\test\unit_test.hpp>
+
+#ifdef BOOST_GIL_OPENCV_USE_MAT
+
+#include <boost\gil\extension\opencv\edge_detection.hpp>
+#include <boost\gil\extension\opencv\mat_wrapper.hpp>
+
+using namespace boost::gil;
+using namespace boost::gil::opencv;
+
+BOOST_AUTO_TEST_CASE( test_cv_mat )
+{
+    rgb8_image_t img( 640, 480 );
+
+    rgb8_view_t sub = subimage_view( view( img ), 10, 20, 100, 50 );
+
+    cv::Mat mat = create_cv_mat( sub );
+
+    BOOST_CHECK_EQUAL( mat.cols, 100     );
+    BOOST_CHECK_EQUAL( mat.rows, 50      );
+    BOOST_CHECK_EQUAL( mat.step, 640 * 3 );
+    BOOST_CHECK_EQUAL( mat.type(), CV_8UC3 );
+    BOOST_CHECK( mat.data == (uchar*) &sub( 0, 0 ));
+}
+
+BOOST_AUTO_TEST_CASE( test_cv_mat_from_ipl_image )
+{
+    rgb8_image_t img( 640, 480 );
+
+    ipl_image_wrapper ipl_img = create_ipl_image( view( img ));
+
+    cv::Mat mat = create_cv_mat( ipl_img );
+
+    BOOST_CHECK( mat.data == (uchar*) ipl_img.get()->imageData );
+    BOOST_CHECK_EQUAL( mat.step, 640 * 3 );
+}
+
+BOOST_AUTO_TEST_CASE( test_cv_mat_result_outside_view )
+{
+    gray8_image_t src( 64, 48 );
+    gray8_image_t dst( 32, 24 );
+
+    ipl_image_wrapper src_ipl = create_ipl_image( view( src ));
+    ipl_image_wrapper dst_ipl = create_ipl_image( view( dst ));
+
+    // OpenCV would allocate a result of the source size instead of writing into dst
+    BOOST_CHECK_THROW( sobel( src_ipl, dst_ipl, aperture3() ), std::runtime_error );
+}
+
+#endif // BOOST_GIL_OPENCV_USE_MAT
@@ -1,5 +1,9 @@
 #include "stdafx.h"
 
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
 #include <boost\test\unit_test.hpp>
 
 #include <boost\gil\extension\opencv\smooth.hpp>
@@ -23,3 +27,161 @@ BOOST_AUTO_TEST_CASE( test_smooth_gaussian )
 
     write_view( "..\\out\\smooth_gaussian.png", view( dst ), png_tag() );
 }
+
+BOOST_AUTO_TEST_CASE( test_smooth_blur_constant )
+{
+    rgb8_image_t src( 640, 480 );
+    fill_pixels( view( src ), rgb8_pixel_t( 10, 20, 30 ) );
+
+    rgb8_image_t dst( view( src ).dimensions() );
+
+    smooth( view( src )
+          , view( dst )
+          , blur()
+          , 5
+          , 3
+          );
+
+    BOOST_CHECK( view( dst )( 0, 0 )     == rgb8_pixel_t( 10, 20, 30 ));
+    BOOST_CHECK( view( dst )( 320, 240 ) == rgb8_pixel_t( 10, 20, 30 ));
+
+    smooth( view( src )
+          , view( dst )
+          , blur_no_scale()
+          , 3
+          );
+
+    BOOST_CHECK( view( dst )( 320, 240 ) == rgb8_pixel_t( 90, 180, 255 ));
+}
+
+BOOST_AUTO_TEST_CASE( test_smooth_blur_wide_channels )
+{
+    gray32_image_t src( 64, 48 );
+    fill_pixels( view( src ), gray32_pixel_t( 4000000001u ));
+
+    gray32_image_t dst( view( src ).dimensions() );
+
+    box_filter( view( src ), view( dst ), 5 );
+
+    BOOST_CHECK( view( dst )( 32, 24 ) == gray32_pixel_t( 4000000001u ));
+}
+
+BOOST_AUTO_TEST_CASE( test_smooth_gaussian_planar )
+{
+    rgb8_planar_image_t src( 640, 480 );
+    fill_pixels( view( src ), rgb8_pixel_t( 0, 0, 0 ) );
+    view( src )( 320, 240 ) = rgb8_pixel_t( 255, 255, 255 );
+
+    rgb8_planar_image_t dst( view( src ).dimensions() );
+
+    gaussian_filter( view( src ), view( dst ), 3 );
+
+    // 255 * 0.5 * 0.5, 255 * 0.25 * 0.5
+    BOOST_CHECK_EQUAL( (int) view( dst )( 320, 240 )[0], 64 );
+    BOOST_CHECK_EQUAL( (int) view( dst )( 321, 240 )[1], 32 );
+    BOOST_CHECK_EQUAL( (int) view( dst )( 320, 239 )[2], 32 );
+}
+
+BOOST_AUTO_TEST_CASE( test_smooth_in_place_threads )
+{
+    rgb8_image_t src;
+    read_image( "..\\in\\in.png", src, png_tag() );
+
+    rgb8_image_t dst( view( src ).dimensions() );
+
+    gaussian_filter( view( src ), view( dst ), 7, 7, 0, 0, 1 );
+    gaussian_filter( view( src ), view( src ), 7, 7, 0, 0, 4 );
+
+    BOOST_CHECK( equal_pixels( view( src ), view( dst )));
+}
+
+BOOST_AUTO_TEST_CASE( test_smooth_median )
+{
+    gray8_image_t src( 640, 480 );
+    fill_pixels( view( src ), gray8_pixel_t( 100 ) );
+
+    // salt and pepper
+    view( src )( 10, 10 ) = gray8_pixel_t( 255 );
+    view( src )( 11, 10 ) = gray8_pixel_t( 0   );
+    view( src )( 0 , 0  ) = gray8_pixel_t( 255 );
+
+    gray8_image_t dst( view( src ).dimensions() );
+
+    smooth( view( src )
+          , view( dst )
+          , median()
+          , 15
+          );
+
+    BOOST_CHECK( view( dst )( 10, 10 ) == gray8_pixel_t( 100 ));
+    BOOST_CHECK( view( dst )( 11, 10 ) == gray8_pixel_t( 100 ));
+    BOOST_CHECK( view( dst )( 0 , 0  ) == gray8_pixel_t( 100 ));
+}
+
+// median of the kernel around every pixel, with replicated borders
+void brute_force_median( const rgb8c_view_t& src
+                       , const rgb8_view_t&  dst
+                       , int                 kernel_size
+                       )
+{
+    const int w = static_cast< int >( src.width()  );
+    const int h = static_cast< int >( src.height() );
+    const int r = kernel_size / 2;
+
+    std::vector< bits8 > values;
+
+    for( int y = 0; y < h; ++y )
+    {
+        for( int x = 0; x < w; ++x )
+        {
+            for( int c = 0; c < 3; ++c )
+            {
+                values.clear();
+
+                for( int dy = -r; dy <= r; ++dy )
+                {
+                    for( int dx = -r; dx <= r; ++dx )
+                    {
+                        int sx = (std::min)( (std::max)( x + dx, 0 ), w - 1 );
+                        int sy = (std::min)( (std::max)( y + dy, 0 ), h - 1 );
+
+                        values.push_back( src( sx, sy )[c] );
+                    }
+                }
+
+                std::nth_element( values.begin(), values.begin() + values.size() / 2, values.end() );
+
+                dst( x, y )[c] = values[ values.size() / 2 ];
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_smooth_median_random )
+{
+    // wide enough for several column strips
+    rgb8_image_t src( 1000, 40 );
+
+    std::srand( 1 );
+
+    for( int y = 0; y < 40; ++y )
+    {
+        for( int x = 0; x < 1000; ++x )
+        {
+            view( src )( x, y ) = rgb8_pixel_t( std::rand() & 255, std::rand() & 255, std::rand() & 255 );
+        }
+    }
+
+    const int kernel_sizes[] = { 3, 9, 21 };
+
+    for( int i = 0; i < 3; ++i )
+    {
+        rgb8_image_t expected( view( src ).dimensions() );
+        brute_force_median( const_view( src ), view( expected ), kernel_sizes[i] );
+
+        rgb8_image_t dst( src );
+        median_filter( view( dst ), view( dst ), kernel_sizes[i], 3 );
+
+        BOOST_CHECK( equal_pixels( view( dst ), view( expected )));
+    }
+}